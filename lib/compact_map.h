@@ -0,0 +1,46 @@
+#ifndef COMPACT_MAP_H
+#define COMPACT_MAP_H
+
+#include "memory_usage.h"
+#include "spheric.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class EarthMap;
+
+// Read-only compact copy of an EarthMap. Places are numbered with 32-bit
+// ids and stored column-wise: one radius for the whole map, fixed-point
+// latitude and longitude in units of 1e-7 degree, names packed in a single
+// string and connections as 32-bit CSR arrays. Connection types are not
+// kept, distance() follows every connection like EarthMap::distance().
+//
+// Rounding moves a place by at most 0.5e-7 degree on each axis, that is
+// under 8 mm on the Earth, so every connection length is within 16 mm of
+// the one computed by EarthMap.
+class CompactMap {
+	double radius;
+	std::vector<int32_t> latitudes;
+	std::vector<int32_t> longitudes;
+	std::string names;
+	std::vector<uint32_t> name_offsets;
+	std::vector<uint32_t> by_name;
+	std::vector<uint32_t> offsets;
+	std::vector<uint32_t> targets;
+public:
+	static const uint32_t npos = UINT32_MAX;
+	static constexpr double resolution = 1e-7;
+	CompactMap(const EarthMap &map);
+	inline uint32_t size() const { return latitudes.size(); }
+	inline double getRadius() const { return radius; }
+	std::string getName(uint32_t id) const;
+	// npos if there is no such place
+	uint32_t getId(const std::string &name) const;
+	// latitude and longitude in radians
+	double getLatitude(uint32_t id) const;
+	double getLongitude(uint32_t id) const;
+	long distance(const std::string &name1, const std::string &name2) const;
+	MemoryUsage memoryUsage() const;
+};
+
+#endif
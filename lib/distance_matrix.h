@@ -0,0 +1,35 @@
+#ifndef DISTANCE_MATRIX_H
+#define DISTANCE_MATRIX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// Dense rows x cols table of distances in metres, -1 meaning no route.
+// Every row starts on a cache line.
+class DistanceMatrix {
+	struct Free {
+		void operator()(int64_t *p) const;
+	};
+	size_t _rows;
+	size_t _cols;
+	size_t _stride;
+	std::unique_ptr<int64_t[], Free> _data;
+public:
+	static const size_t alignment = 64;
+	DistanceMatrix(size_t rows, size_t cols);
+	inline size_t rows() const { return _rows; }
+	inline size_t cols() const { return _cols; }
+	inline int64_t* row(size_t i) { return _data.get() + i*_stride; }
+	inline const int64_t* row(size_t i) const { return _data.get() + i*_stride; }
+	inline int64_t& operator()(size_t i, size_t j) { return row(i)[j]; }
+	inline int64_t operator()(size_t i, size_t j) const { return row(i)[j]; }
+	// binary file: "GOSDM1\0\0", rows and cols as uint64, then the rows
+	// as int64 without padding, all in the byte order of the machine; load()
+	// rejects a header that does not match the size of the file
+	void save(const std::string &path) const;
+	static DistanceMatrix load(const std::string &path);
+};
+
+#endif
@@ -3,9 +3,16 @@
 
 #include "graph.h"
 #include "spheric.h"
+#include "distance_matrix.h"
+#include "compact_map.h"
+#include "union_find.h"
+#include <mutex>
 #include <string>
+#include <unordered_map>
 
 enum connectionType { TRAIN, BOAT };
+const connectionType connectionTypes[] = { TRAIN, BOAT };
+enum placeOrder { MORTON, CUTHILL_MCKEE };
 
 class Place {
 	std::string _name;
@@ -17,16 +24,106 @@ public:
 	bool operator==(const Place& p);
 };
 
+struct Connection {
+	std::string from;
+	std::string to;
+	connectionType type;
+};
+
+// Memory of a bounded search, kept from one call to the next: arrays the
+// size of the map are allocated once and invalidated by bumping round
+// instead of being cleared. A place is reached in the current search when
+// its stamp is round, settled when it is round + 1.
+class SearchScratch {
+	friend class EarthMap;
+	friend class Landmarks;
+	std::vector<double> dist;
+	std::vector<uint32_t> stamp;
+	uint32_t round = 0;
+	std::vector<std::pair<double,size_t>> heap;
+	void reset(size_t size);
+};
+
+// Connected components of the map, over all connections and per
+// connectionType. Insertions are applied incrementally, deletions
+// invalidate the index which is then rebuilt by the next query.
+struct ReachabilityIndex {
+	std::unordered_map<const Node<Place>*,size_t> ids;
+	UnionFind any;
+	std::map<connectionType,UnionFind> by_type;
+	bool valid = false;
+	std::mutex mutex;
+};
+
+// Locations of the places in getAdjacency() order, so that searches read
+// them in the order chosen by reorderPlaces instead of chasing the nodes.
+// Rebuilt on first use after any change of the map.
+struct LocationCache {
+	std::vector<Spheric<3>> locations;
+	uint64_t revision = 0;
+	bool valid = false;
+	std::mutex mutex;
+};
+
 class EarthMap : private Graph<Place, connectionType> {
+	friend class CompactMap;
+	friend class ShardedRouter;
+	friend class Landmarks;
 	std::map<const std::string, const Node<Place>*> places;
+	mutable ReachabilityIndex reachability;
+	mutable LocationCache location_cache;
+	// bumped by every change of the places, their order or the connections
+	uint64_t revision = 0;
 public:
 	void addPlace(const std::string &name, double latitude, double longitude);
+	void addPlace(const std::string &name, const Spheric<3> &location);
 	void deletePlace(const std::string &name);
 	void addConnection(const std::string &name1, const std::string &name2, const connectionType &ct);
 	void removeConnection(std::string name1, std::string name2, connectionType ct);
-	long distance(const std::string &name1, const std::string &name2);
+	void reserve(size_t place_count, size_t connection_count);
+	std::vector<const Place*> getPlaces() const;
+	// each connection once, not once per direction
+	std::vector<Connection> getConnections() const;
+	// shortest route length in metres, -1 if there is none
+	long distance(const std::string &name1, const std::string &name2) const;
+	// one-to-many: a single search from source serves every target
+	std::vector<long> distances(const std::string &source, const std::vector<std::string> &targets) const;
+	// many-to-many: one search per source, or one backward search per
+	// target when there are fewer targets, spread over nthreads threads
+	DistanceMatrix distanceMatrix(const std::vector<std::string> &sources, const std::vector<std::string> &targets, unsigned nthreads = 0) const;
+	// places within budget metres of name with their distances, nearest first
+	std::vector<std::pair<std::string,long>> isochrone(const std::string &name, long budget, SearchScratch &scratch) const;
+	std::vector<std::pair<std::string,long>> isochrone(const std::string &name, long budget, connectionType ct, SearchScratch &scratch) const;
+	// one isochrone per origin, computed by nthreads threads
+	std::vector<std::vector<std::pair<std::string,long>>> isochrones(const std::vector<std::string> &origins, long budget, unsigned nthreads = 0) const;
+	std::vector<std::vector<std::pair<std::string,long>>> isochrones(const std::vector<std::string> &origins, long budget, connectionType ct, unsigned nthreads = 0) const;
+	bool reachable(const std::string &name1, const std::string &name2) const;
+	bool reachable(const std::string &name1, const std::string &name2, connectionType ct) const;
+	// renumbers places along a space-filling curve or by bandwidth reduction
+	// of the connections so that traversals touch memory in order
+	void reorderPlaces(placeOrder order = MORTON);
+	// names of the places of each of count geographic parts of equal size,
+	// cut along the same space-filling curve as reorderPlaces
+	std::vector<std::vector<std::string>> partition(unsigned count) const;
+	CompactMap compact() const;
+	inline uint64_t getRevision() const { return revision; }
+	MemoryUsage memoryUsage() const;
 private:
-	const Node<Place>* getPlace(const std::string &name);
+	const Node<Place>* getPlace(const std::string &name) const;
+	bool reachable(const Node<Place> *n1, const Node<Place> *n2, const connectionType *ct) const;
+	void buildReachability() const;
+	const std::vector<Spheric<3>>& getLocations() const;
+	// indices in getNodes() sorted by Z-order of the locations
+	std::vector<size_t> mortonOrder() const;
+	// Dijkstra over getAdjacency(), stopped once every target is settled or
+	// run over the whole map when there is no target; backward follows the
+	// edges from their end to their start. parent receives the predecessor
+	// of each place in the shortest path tree (the place count for the
+	// source and unreached places), order the places as they are settled.
+	void shortestPaths(size_t source, const std::vector<size_t> &targets, std::vector<double> &dist, bool backward = false,
+		std::vector<size_t> *parent = nullptr, std::vector<size_t> *order = nullptr) const;
+	std::vector<std::pair<std::string,long>> isochrone(const Node<Place> *origin, long budget, const connectionType *ct, SearchScratch &scratch) const;
+	std::vector<std::vector<std::pair<std::string,long>>> isochrones(const std::vector<std::string> &origins, long budget, const connectionType *ct, unsigned nthreads) const;
 };
 
 
@@ -1,6 +1,8 @@
 #ifndef GRAPH_H
 #define GRAPH_H
 
+#include "memory_usage.h"
+#include "union_find.h"
 #include <list>
 #include <stdexcept>
 #include <vector>
@@ -8,13 +10,25 @@
 #include <queue>
 #include <set>
 #include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <utility>
 
 template <class T>
 class Node {
 	T _data;
 public:
 	Node(const T &data);
+	Node(T &&data);
+	template <class... Args>
+	explicit Node(std::in_place_t, Args&&... args);
 	void setData(const T &data) { _data = data; }
+	void setData(T &&data) { _data = std::move(data); }
 	inline const T& getData() const { return _data; }
 };
 
@@ -23,21 +37,51 @@ class Edge {
 	T _annotation;
 public:
 	Edge(const T &annotation);
+	Edge(T &&annotation);
+	template <class... Args>
+	explicit Edge(std::in_place_t, Args&&... args);
 	void setAnnotation(const T &annotation) { _annotation = annotation; }
+	void setAnnotation(T &&annotation) { _annotation = std::move(annotation); }
 	inline const T& getAnnotation() const { return _annotation; }
 };
 
+// Dense view of a graph: nodes are numbered by their position in
+// Graph::getNodes() and edges are stored as offsets/targets arrays (CSR),
+// in both directions.
+template <class N, class E>
+struct Adjacency {
+	std::vector<const Node<N>*> nodes;
+	std::unordered_map<const Node<N>*,size_t> index;
+	std::vector<size_t> out_offsets;
+	std::vector<size_t> out_targets;
+	std::vector<const Edge<E>*> out_edges;
+	std::vector<size_t> in_offsets;
+	std::vector<size_t> in_sources;
+	std::vector<const Edge<E>*> in_edges;
+};
+
 template <class N, class E>
 class Graph {
 	std::vector<Node<N>*> nodes;
 	std::vector<Edge<E>*> edges;
 	std::map<const Node<N>*,std::list<Edge<E>*>> incident_edges;
 	std::map<const Edge<E>*,std::pair<Node<N>*,Node<N>*>> incident_nodes;
+	// built on demand, dropped by every structural change
+	mutable std::unique_ptr<Adjacency<N,E>> adjacency;
+	mutable std::mutex adjacency_mutex;
 public:
 	~Graph();
 	const Node<N>* addNode(const N &data);
+	const Node<N>* addNode(N &&data);
+	// builds the payload in place from args
+	template <class... Args>
+	const Node<N>* emplaceNode(Args&&... args);
 	const Edge<E>* addEdge(const E &annotation, const N &d1, const N &d2);
 	const Edge<E>* addEdge(const E &annotation, const Node<N> *n1, const Node<N> *n2);
+	template <class... Args>
+	const Edge<E>* emplaceEdge(const Node<N> *n1, const Node<N> *n2, Args&&... args);
+	// room for that many nodes and edges in total
+	void reserve(size_t node_count, size_t edge_count);
 	void deleteNode(const N &data);
 	void deleteNode(const Node<N> *node);
 	void deleteEdge(const Edge<E> *edge);
@@ -53,20 +97,104 @@ public:
 	Function breadthFirst(const Node<N> * start, Function fn) const;
 	template <class Function>
 	Function breadthFirst(const N &start, Function fn) const;
+	// visitor(node, depth) is called once per reached node, concurrently
+	// from up to nthreads threads (0 = hardware concurrency)
+	template <class Visitor>
+	Visitor parallelBreadthFirst(const Node<N> *start, Visitor visitor, unsigned nthreads = 0) const;
+	template <class Visitor>
+	Visitor parallelBreadthFirst(const N &start, Visitor visitor, unsigned nthreads = 0) const;
+	// weakly connected components, restricted to the edges with the given
+	// annotation if any: the component of getAdjacency().nodes[i] is the
+	// smallest index of its members
+	std::vector<size_t> components(unsigned nthreads = 0) const;
+	std::vector<size_t> components(const E &annotation, unsigned nthreads) const;
+	const Adjacency<N,E>& getAdjacency() const;
+	// order[i] is the current index of the node moved to position i;
+	// edges and incidence lists are regrouped to follow the new order
+	void reorder(const std::vector<size_t> &order);
+	std::vector<size_t> reverseCuthillMcKee() const;
+	// payloads are counted by sizeof only, not what they own on the heap
+	MemoryUsage memoryUsage() const;
 private:
+	std::vector<size_t> components(const E *annotation, unsigned nthreads) const;
 	typename std::vector<Node<N>*>::const_iterator getNode(const N &data) const;
 	typename std::vector<Edge<E>*>::const_iterator getEdge(const E &annotation, const Node<N> *n1, const Node<N> *n2) const;
 	const Edge<E>* addEdge(const E &annotation, typename std::vector<Node<N>*>::const_iterator it1, typename std::vector<Node<N>*>::const_iterator it2);
+	Node<N>* findNode(const Node<N> *node) const;
+	const Node<N>* insertNode(Node<N> *node);
+	const Edge<E>* insertEdge(Edge<E> *edge, Node<N> *n1, Node<N> *n2);
 	void deleteNode(typename std::vector<Node<N>*>::const_iterator it_node);
 	void deleteEdge(typename std::vector<Edge<E>*>::const_iterator it_edge);
+	void invalidate() { adjacency.reset(); }
+};
+
+// Reusable barrier for count threads: the last one to arrive runs
+// completion before the others are released.
+class Barrier {
+	std::mutex mutex;
+	std::condition_variable released;
+	const unsigned count;
+	unsigned waiting = 0;
+	uint64_t generation = 0;
+public:
+	explicit Barrier(unsigned count) : count(count) {}
+	template <class Function>
+	void wait(Function completion) {
+		std::unique_lock<std::mutex> lock(mutex);
+		uint64_t arrived = generation;
+		if (++waiting == count) {
+			completion();
+			waiting = 0;
+			generation++;
+			released.notify_all();
+		}
+		else {
+			released.wait(lock, [&]() { return generation != arrived; });
+		}
+	}
 };
 
+// Runs fn(thread, begin, end) over [0, count) split in nthreads ranges.
+template <class Function>
+void parallelFor(size_t count, unsigned nthreads, Function fn) {
+	if (nthreads == 0)
+		nthreads = std::max(1u, std::thread::hardware_concurrency());
+	nthreads = std::max(1u, (unsigned) std::min<size_t>(nthreads, count));
+	if (nthreads == 1) {
+		fn(0u, (size_t) 0, count);
+		return;
+	}
+	std::vector<std::thread> threads;
+	size_t chunk = (count + nthreads - 1) / nthreads;
+	for (unsigned t = 0; t < nthreads; t++) {
+		size_t begin = std::min(count, t*chunk);
+		size_t end = std::min(count, begin + chunk);
+		threads.emplace_back(fn, t, begin, end);
+	}
+	for (std::thread &t: threads)
+		t.join();
+}
+
 template <class T>
 Node<T>::Node(const T &data) : _data(data) {}
 
+template <class T>
+Node<T>::Node(T &&data) : _data(std::move(data)) {}
+
+template <class T>
+template <class... Args>
+Node<T>::Node(std::in_place_t, Args&&... args) : _data(std::forward<Args>(args)...) {}
+
 template <class T>
 Edge<T>::Edge(const T &annotation) : _annotation(annotation) {}
 
+template <class T>
+Edge<T>::Edge(T &&annotation) : _annotation(std::move(annotation)) {}
+
+template <class T>
+template <class... Args>
+Edge<T>::Edge(std::in_place_t, Args&&... args) : _annotation(std::forward<Args>(args)...) {}
+
 template <class N, class E>
 Graph<N,E>::~Graph() {
 	for (auto it = nodes.begin(); it != nodes.end(); it++)
@@ -77,10 +205,18 @@ Graph<N,E>::~Graph() {
 
 template <class N, class E>
 const Node<N> * Graph<N,E>::addNode(const N &data) {
-	Node<N> *n = new Node<N>(data);
-	nodes.push_back(n);
-	incident_edges[n] = std::list<Edge<E>*>();
-	return n;
+	return insertNode(new Node<N>(data));
+}
+
+template <class N, class E>
+const Node<N> * Graph<N,E>::addNode(N &&data) {
+	return insertNode(new Node<N>(std::move(data)));
+}
+
+template <class N, class E>
+template <class... Args>
+const Node<N> * Graph<N,E>::emplaceNode(Args&&... args) {
+	return insertNode(new Node<N>(std::in_place, std::forward<Args>(args)...));
 }
 
 template <class N, class E>
@@ -90,13 +226,32 @@ const Edge<E>* Graph<N,E>::addEdge(const E &annotation, const N &d1, const N &d2
 
 template <class N, class E>
 const Edge<E> * Graph<N,E>::addEdge(const E &annotation, const Node<N> * n1, const Node<N> * n2) {
-	auto it_n1 = std::find(nodes.begin(), nodes.end(), n1);
-	auto it_n2 = std::find(nodes.begin(), nodes.end(), n2);
-	if (it_n1 == nodes.end() || it_n2 == nodes.end())
+	Node<N> *p1 = findNode(n1);
+	Node<N> *p2 = findNode(n2);
+	if (p1 == nullptr || p2 == nullptr)
 		throw std::invalid_argument("Graph::addEdge: node is not in the graph");
-	if (connected(annotation, *it_n1, *it_n2))
+	if (connected(annotation, p1, p2))
 		throw std::invalid_argument("Graph::addEdge: edge exists");
-	return addEdge(annotation, it_n1, it_n2);
+	return insertEdge(new Edge<E>(annotation), p1, p2);
+}
+
+template <class N, class E>
+template <class... Args>
+const Edge<E> * Graph<N,E>::emplaceEdge(const Node<N> *n1, const Node<N> *n2, Args&&... args) {
+	Node<N> *p1 = findNode(n1);
+	Node<N> *p2 = findNode(n2);
+	if (p1 == nullptr || p2 == nullptr)
+		throw std::invalid_argument("Graph::emplaceEdge: node is not in the graph");
+	std::unique_ptr<Edge<E>> edge(new Edge<E>(std::in_place, std::forward<Args>(args)...));
+	if (connected(edge->getAnnotation(), p1, p2))
+		throw std::invalid_argument("Graph::emplaceEdge: edge exists");
+	return insertEdge(edge.release(), p1, p2);
+}
+
+template <class N, class E>
+void Graph<N,E>::reserve(size_t node_count, size_t edge_count) {
+	nodes.reserve(node_count);
+	edges.reserve(edge_count);
 }
 
 template <class N, class E>
@@ -137,7 +292,14 @@ bool Graph<N,E>::connected(const E &annotation, const N &d1, const N &d2) const
 
 template <class N, class E>
 bool Graph<N,E>::connected(const E &annotation, const Node<N> *n1, const Node<N> *n2) const {
-	return getEdge(annotation, n1, n2) != edges.end();
+	// only the edges leaving n1 can match
+	auto it_list = incident_edges.find(n1);
+	if (it_list == incident_edges.end())
+		return false;
+	for (const Edge<E> *edge: it_list->second)
+		if (edge->getAnnotation() == annotation && incident_nodes.at(edge).second == n2)
+			return true;
+	return false;
 }
 
 template <class N, class E>
@@ -191,6 +353,305 @@ Function Graph<N,E>::breadthFirst(const N &start, Function fn) const {
 	return breadthFirst(*getNode(start), fn);
 }
 
+template <class N, class E>
+template <class Visitor>
+Visitor Graph<N,E>::parallelBreadthFirst(const Node<N> *start, Visitor visitor, unsigned nthreads) const {
+	const Adjacency<N,E> &adj = getAdjacency();
+	auto it_start = adj.index.find(start);
+	if (it_start == adj.index.end())
+		throw std::invalid_argument("Graph::parallelBreadthFirst: node is not in the graph");
+	const size_t n = adj.nodes.size();
+	if (nthreads == 0)
+		nthreads = std::max(1u, std::thread::hardware_concurrency());
+	// visited bitmap, one bit per node
+	std::vector<std::atomic<uint64_t>> visited((n + 63) / 64);
+	for (auto &word: visited)
+		word.store(0, std::memory_order_relaxed);
+	auto visit = [&visited](size_t i) {
+		uint64_t bit = uint64_t(1) << (i % 64);
+		return (visited[i / 64].fetch_or(bit, std::memory_order_relaxed) & bit) == 0;
+	};
+	auto isVisited = [&visited](size_t i) {
+		return (visited[i / 64].load(std::memory_order_relaxed) >> (i % 64)) & 1;
+	};
+
+	std::vector<size_t> frontier(1, it_start->second);
+	visit(it_start->second);
+	visitor(start, 0u);
+	std::vector<std::vector<size_t>> local(nthreads);
+	std::vector<char> in_frontier;
+	// Beamer et al. heuristic: go bottom-up when the edges leaving the
+	// frontier outnumber alpha-th of the edges left to check, go back
+	// top-down when the frontier shrinks under n/beta nodes
+	const size_t alpha = 14, beta = 24;
+	size_t unexplored_edges = adj.out_targets.size();
+	bool bottom_up = false;
+	unsigned depth = 1;
+	// serial step between levels, run by the last thread to finish one
+	auto prepare = [&]() {
+		size_t frontier_edges = 0;
+		for (size_t u: frontier)
+			frontier_edges += adj.out_offsets[u+1] - adj.out_offsets[u];
+		unexplored_edges -= std::min(unexplored_edges, frontier_edges);
+		if (!bottom_up && frontier_edges > unexplored_edges / alpha)
+			bottom_up = true;
+		else if (bottom_up && frontier.size() < n / beta)
+			bottom_up = false;
+		if (bottom_up) {
+			in_frontier.assign(n, 0);
+			for (size_t u: frontier)
+				in_frontier[u] = 1;
+		}
+		for (auto &l: local)
+			l.clear();
+	};
+	auto next = [&]() {
+		frontier.clear();
+		for (auto &l: local)
+			frontier.insert(frontier.end(), l.begin(), l.end());
+		depth++;
+		if (!frontier.empty())
+			prepare();
+	};
+	// the same threads run every level, separated by a barrier
+	Barrier barrier(nthreads);
+	auto worker = [&](unsigned t) {
+		while (!frontier.empty()) {
+			if (bottom_up) {
+				size_t chunk = (n + nthreads - 1) / nthreads;
+				size_t begin = std::min(n, t*chunk), end = std::min(n, begin + chunk);
+				for (size_t v = begin; v < end; v++) {
+					if (isVisited(v))
+						continue;
+					for (size_t k = adj.in_offsets[v]; k < adj.in_offsets[v+1]; k++) {
+						if (in_frontier[adj.in_sources[k]]) {
+							visit(v);
+							local[t].push_back(v);
+							visitor(adj.nodes[v], depth);
+							break;
+						}
+					}
+				}
+			}
+			else {
+				size_t chunk = (frontier.size() + nthreads - 1) / nthreads;
+				size_t begin = std::min(frontier.size(), t*chunk), end = std::min(frontier.size(), begin + chunk);
+				for (size_t i = begin; i < end; i++) {
+					size_t u = frontier[i];
+					for (size_t k = adj.out_offsets[u]; k < adj.out_offsets[u+1]; k++) {
+						size_t v = adj.out_targets[k];
+						if (!isVisited(v) && visit(v)) {
+							local[t].push_back(v);
+							visitor(adj.nodes[v], depth);
+						}
+					}
+				}
+			}
+			barrier.wait(next);
+		}
+	};
+	prepare();
+	std::vector<std::thread> threads;
+	for (unsigned t = 1; t < nthreads; t++)
+		threads.emplace_back(worker, t);
+	worker(0);
+	for (std::thread &t: threads)
+		t.join();
+	return visitor;
+}
+
+template <class N, class E>
+template <class Visitor>
+Visitor Graph<N,E>::parallelBreadthFirst(const N &start, Visitor visitor, unsigned nthreads) const {
+	auto it = getNode(start);
+	if (it == nodes.cend())
+		throw std::invalid_argument("Graph::parallelBreadthFirst: node is not in the graph");
+	return parallelBreadthFirst(*it, visitor, nthreads);
+}
+
+template <class N, class E>
+std::vector<size_t> Graph<N,E>::components(unsigned nthreads) const {
+	return components(nullptr, nthreads);
+}
+
+template <class N, class E>
+std::vector<size_t> Graph<N,E>::components(const E &annotation, unsigned nthreads) const {
+	return components(&annotation, nthreads);
+}
+
+template <class N, class E>
+std::vector<size_t> Graph<N,E>::components(const E *annotation, unsigned nthreads) const {
+	const Adjacency<N,E> &adj = getAdjacency();
+	const size_t n = adj.nodes.size();
+	UnionFind uf(n);
+	parallelFor(n, nthreads, [&](unsigned, size_t begin, size_t end) {
+		for (size_t u = begin; u < end; u++)
+			for (size_t k = adj.out_offsets[u]; k < adj.out_offsets[u+1]; k++)
+				if (annotation == nullptr || adj.out_edges[k]->getAnnotation() == *annotation)
+					uf.unite(u, adj.out_targets[k]);
+	});
+	std::vector<size_t> roots(n);
+	parallelFor(n, nthreads, [&](unsigned, size_t begin, size_t end) {
+		for (size_t u = begin; u < end; u++)
+			roots[u] = uf.find(u);
+	});
+	return roots;
+}
+
+template <class N, class E>
+const Adjacency<N,E>& Graph<N,E>::getAdjacency() const {
+	std::lock_guard<std::mutex> lock(adjacency_mutex);
+	if (adjacency)
+		return *adjacency;
+	std::unique_ptr<Adjacency<N,E>> adj(new Adjacency<N,E>());
+	const size_t n = nodes.size();
+	adj->nodes.assign(nodes.begin(), nodes.end());
+	adj->index.reserve(n);
+	for (size_t i = 0; i < n; i++)
+		adj->index[nodes[i]] = i;
+	adj->out_offsets.assign(n + 1, 0);
+	adj->in_offsets.assign(n + 1, 0);
+	std::vector<std::pair<size_t,size_t>> ends;
+	ends.reserve(edges.size());
+	for (const Edge<E> *edge: edges) {
+		auto pair = incident_nodes.at(edge);
+		size_t from = adj->index.at(pair.first);
+		size_t to = adj->index.at(pair.second);
+		ends.push_back(std::make_pair(from, to));
+		adj->out_offsets[from+1]++;
+		adj->in_offsets[to+1]++;
+	}
+	for (size_t i = 0; i < n; i++) {
+		adj->out_offsets[i+1] += adj->out_offsets[i];
+		adj->in_offsets[i+1] += adj->in_offsets[i];
+	}
+	adj->out_targets.resize(edges.size());
+	adj->out_edges.resize(edges.size());
+	adj->in_sources.resize(edges.size());
+	adj->in_edges.resize(edges.size());
+	std::vector<size_t> out_pos(adj->out_offsets.begin(), adj->out_offsets.end() - 1);
+	std::vector<size_t> in_pos(adj->in_offsets.begin(), adj->in_offsets.end() - 1);
+	for (size_t k = 0; k < edges.size(); k++) {
+		size_t from = ends[k].first, to = ends[k].second;
+		adj->out_targets[out_pos[from]] = to;
+		adj->out_edges[out_pos[from]++] = edges[k];
+		adj->in_sources[in_pos[to]] = from;
+		adj->in_edges[in_pos[to]++] = edges[k];
+	}
+	adjacency = std::move(adj);
+	return *adjacency;
+}
+
+template <class N, class E>
+void Graph<N,E>::reorder(const std::vector<size_t> &order) {
+	const size_t n = nodes.size();
+	if (order.size() != n)
+		throw std::invalid_argument("Graph::reorder: order is not a permutation of the nodes");
+	std::vector<char> seen(n, 0);
+	for (size_t i: order) {
+		if (i >= n || seen[i])
+			throw std::invalid_argument("Graph::reorder: order is not a permutation of the nodes");
+		seen[i] = 1;
+	}
+	std::vector<Node<N>*> reordered(n);
+	for (size_t i = 0; i < n; i++)
+		reordered[i] = nodes[order[i]];
+	nodes.swap(reordered);
+	std::unordered_map<const Node<N>*,size_t> rank;
+	rank.reserve(n);
+	for (size_t i = 0; i < n; i++)
+		rank[nodes[i]] = i;
+	// edges sorted by source then target in the new order
+	std::vector<std::pair<std::pair<size_t,size_t>,Edge<E>*>> keyed;
+	keyed.reserve(edges.size());
+	for (Edge<E> *edge: edges) {
+		auto pair = incident_nodes.at(edge);
+		keyed.push_back(std::make_pair(std::make_pair(rank[pair.first], rank[pair.second]), edge));
+	}
+	std::stable_sort(keyed.begin(), keyed.end(),
+		[](const std::pair<std::pair<size_t,size_t>,Edge<E>*> &a, const std::pair<std::pair<size_t,size_t>,Edge<E>*> &b) {
+			return a.first < b.first;
+		});
+	for (size_t k = 0; k < keyed.size(); k++)
+		edges[k] = keyed[k].second;
+	for (auto &it: incident_edges) {
+		it.second.sort([this, &rank](const Edge<E> *a, const Edge<E> *b) {
+			return rank[incident_nodes.at(a).second] < rank[incident_nodes.at(b).second];
+		});
+	}
+	invalidate();
+}
+
+template <class N, class E>
+std::vector<size_t> Graph<N,E>::reverseCuthillMcKee() const {
+	const Adjacency<N,E> &adj = getAdjacency();
+	const size_t n = adj.nodes.size();
+	// edges are seen as undirected
+	std::vector<size_t> degree(n);
+	for (size_t u = 0; u < n; u++)
+		degree[u] = adj.out_offsets[u+1] - adj.out_offsets[u] + adj.in_offsets[u+1] - adj.in_offsets[u];
+	auto lower_degree = [&degree](size_t a, size_t b) {
+		return degree[a] < degree[b] || (degree[a] == degree[b] && a < b);
+	};
+	std::vector<size_t> starts(n);
+	for (size_t u = 0; u < n; u++)
+		starts[u] = u;
+	std::sort(starts.begin(), starts.end(), lower_degree);
+	std::vector<char> visited(n, 0);
+	std::vector<size_t> order;
+	order.reserve(n);
+	std::vector<size_t> neighbours;
+	for (size_t start: starts) {
+		if (visited[start])
+			continue;
+		visited[start] = 1;
+		// order itself is the queue
+		order.push_back(start);
+		for (size_t head = order.size() - 1; head < order.size(); head++) {
+			size_t u = order[head];
+			neighbours.clear();
+			for (size_t k = adj.out_offsets[u]; k < adj.out_offsets[u+1]; k++)
+				neighbours.push_back(adj.out_targets[k]);
+			for (size_t k = adj.in_offsets[u]; k < adj.in_offsets[u+1]; k++)
+				neighbours.push_back(adj.in_sources[k]);
+			std::sort(neighbours.begin(), neighbours.end(), lower_degree);
+			for (size_t v: neighbours) {
+				if (!visited[v]) {
+					visited[v] = 1;
+					order.push_back(v);
+				}
+			}
+		}
+	}
+	std::reverse(order.begin(), order.end());
+	return order;
+}
+
+template <class N, class E>
+MemoryUsage Graph<N,E>::memoryUsage() const {
+	MemoryUsage usage;
+	usage.add("node objects", nodes.size() * (sizeof(Node<N>) + MemoryUsage::heap_overhead));
+	usage.add("edge objects", edges.size() * (sizeof(Edge<E>) + MemoryUsage::heap_overhead));
+	usage.add("node vector", MemoryUsage::heap(nodes));
+	usage.add("edge vector", MemoryUsage::heap(edges));
+	usage.add("incident_edges map", incident_edges.size() *
+		(sizeof(typename decltype(incident_edges)::value_type) + MemoryUsage::tree_node));
+	usage.add("incidence lists", edges.size() * (sizeof(Edge<E>*) + MemoryUsage::list_node));
+	usage.add("incident_nodes map", incident_nodes.size() *
+		(sizeof(typename decltype(incident_nodes)::value_type) + MemoryUsage::tree_node));
+	std::lock_guard<std::mutex> lock(adjacency_mutex);
+	if (adjacency) {
+		const Adjacency<N,E> &adj = *adjacency;
+		usage.add("adjacency arrays", MemoryUsage::heap(adj.nodes)
+			+ MemoryUsage::heap(adj.out_offsets) + MemoryUsage::heap(adj.out_targets) + MemoryUsage::heap(adj.out_edges)
+			+ MemoryUsage::heap(adj.in_offsets) + MemoryUsage::heap(adj.in_sources) + MemoryUsage::heap(adj.in_edges));
+		usage.add("adjacency index", adj.index.size() *
+			(sizeof(typename decltype(adj.index)::value_type) + MemoryUsage::hash_node)
+			+ adj.index.bucket_count() * sizeof(void*));
+	}
+	return usage;
+}
+
 template <class N, class E>
 typename std::vector<Node<N>*>::const_iterator Graph<N,E>::getNode(const N &data) const {
 	for (auto it = nodes.cbegin(); it != nodes.cend(); it++) {
@@ -216,11 +677,32 @@ typename std::vector<Edge<E>*>::const_iterator Graph<N,E>::getEdge(const E &anno
 
 template <class N, class E>
 const Edge<E>* Graph<N,E>::addEdge(const E &annotation, typename std::vector<Node<N>*>::const_iterator it1, typename std::vector<Node<N>*>::const_iterator it2) {
-	Edge<E> *e = new Edge<E>(annotation);
-	edges.push_back(e);
-	incident_nodes[e] = std::make_pair(*it1,*it2);
-	incident_edges[*it1].push_back(e);
-	return e;
+	return insertEdge(new Edge<E>(annotation), *it1, *it2);
+}
+
+template <class N, class E>
+Node<N>* Graph<N,E>::findNode(const Node<N> *node) const {
+	// every node of the graph has an entry, even without edges
+	if (incident_edges.find(node) == incident_edges.end())
+		return nullptr;
+	return const_cast<Node<N>*>(node);
+}
+
+template <class N, class E>
+const Node<N>* Graph<N,E>::insertNode(Node<N> *node) {
+	nodes.push_back(node);
+	incident_edges[node] = std::list<Edge<E>*>();
+	invalidate();
+	return node;
+}
+
+template <class N, class E>
+const Edge<E>* Graph<N,E>::insertEdge(Edge<E> *edge, Node<N> *n1, Node<N> *n2) {
+	edges.push_back(edge);
+	incident_nodes[edge] = std::make_pair(n1, n2);
+	incident_edges[n1].push_back(edge);
+	invalidate();
+	return edge;
 }
 
 template <class N, class E>
@@ -234,6 +716,9 @@ void Graph<N,E>::deleteNode(typename std::vector<Node<N>*>::const_iterator it_no
 		if (pair.first == node || pair.second == node) {
 			Edge<E> *edge = *it;
 			auto it2 = edges.erase(it);
+			// edges into node are also listed by their other end
+			if (pair.first != node)
+				incident_edges[pair.first].remove(edge);
 			incident_nodes.erase(edge);
 			delete edge;
 			it = it2;
@@ -244,6 +729,7 @@ void Graph<N,E>::deleteNode(typename std::vector<Node<N>*>::const_iterator it_no
 	}
 	incident_edges.erase(node);
 	delete node;
+	invalidate();
 }
 
 template <class N, class E>
@@ -258,6 +744,7 @@ void Graph<N,E>::deleteEdge(typename std::vector<Edge<E>*>::const_iterator it_ed
 	list_edges.remove(edge);
 	incident_nodes.erase(edge);
 	delete edge;
+	invalidate();
 }
 
 #endif
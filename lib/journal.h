@@ -0,0 +1,62 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include "earth_map.h"
+#include <cstdint>
+#include <string>
+
+// Durable EarthMap: mutations go through this class, which applies them
+// and appends them to a journal in directory. Records are buffered and
+// written with a single fdatasync every group records (group commit) or
+// on commit(). snapshot() writes the whole map compacted and starts an
+// empty journal, so that a restart loads the latest snapshot and replays
+// only the mutations made since. commit() also takes the snapshot once
+// the journal holds snapshot_records records or snapshot_bytes bytes, 0
+// disabling either limit.
+//
+// Files: "snapshot" is "GOSS1\0\0\0", the sequence number, the places
+// and the connections, then a checksum; "journal" is "GOSJ1\0\0\0" and
+// the sequence number it starts from, followed by records framed as
+// size, checksum, payload. A torn record at the end of the journal, left
+// by a crash, is dropped on recovery.
+class JournaledMap {
+	EarthMap &map;
+	const std::string directory;
+	const size_t group;
+	const size_t snapshot_records;
+	const uint64_t snapshot_bytes;
+	int journal_fd;
+	// records in the journal file, and its size header included
+	size_t journal_records;
+	uint64_t journal_bytes;
+	// mutations applied since the map was empty
+	uint64_t sequence;
+	std::string pending;
+	size_t pending_count;
+public:
+	// recovers map, which must be empty, from directory
+	JournaledMap(EarthMap &map, const std::string &directory, size_t group = 64,
+		size_t snapshot_records = 0, uint64_t snapshot_bytes = 0);
+	~JournaledMap();
+	void addPlace(const std::string &name, double latitude, double longitude);
+	void deletePlace(const std::string &name);
+	void addConnection(const std::string &name1, const std::string &name2, connectionType ct);
+	void removeConnection(const std::string &name1, const std::string &name2, connectionType ct);
+	// makes every mutation so far durable
+	void commit();
+	void snapshot();
+	inline uint64_t getSequence() const { return sequence; }
+	inline const EarthMap& getMap() const { return map; }
+private:
+	// writes the pending records without checking the snapshot limits
+	void flush();
+	void recover();
+	void loadSnapshot(const std::string &path);
+	uint64_t replayJournal(const std::string &path);
+	void apply(const std::string &record);
+	void append(const std::string &record);
+	void createJournal();
+	void openJournal();
+};
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef LANDMARKS_H
+#define LANDMARKS_H
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+class EarthMap;
+class SearchScratch;
+
+enum landmarkSelection { FARTHEST, AVOID };
+
+// Landmark (ALT) tables for goal-directed searches on an EarthMap. For k
+// landmarks L the distances d(v, L) and d(L, v) of every place v are kept,
+// and the triangle inequality bounds a route from v to t from below by
+// d(L, t) - d(L, v) and d(v, L) - d(t, L). distance() runs A* on the best of
+// these bounds and of the great-circle distance, which is much tighter when
+// routes detour, such as across the Channel by BOAT.
+//
+// FARTHEST picks each new landmark as far as possible from the previous
+// ones. AVOID grows a shortest path tree from a random place and descends
+// into the subtree where the current bounds are the weakest.
+//
+// The tables follow the numbering of the map at the time they are built:
+// any change to the map makes them stale until refresh() is called.
+class Landmarks {
+	landmarkSelection selection;
+	unsigned count;
+	std::vector<std::string> names;
+	// place-major, k entries per place in getAdjacency() order
+	std::vector<double> to;
+	std::vector<double> from;
+	size_t places;
+	uint64_t revision;
+public:
+	Landmarks(const EarthMap &map, unsigned count, landmarkSelection selection = AVOID, unsigned nthreads = 0);
+	inline size_t size() const { return names.size(); }
+	inline const std::vector<std::string>& getLandmarks() const { return names; }
+	bool isStale(const EarthMap &map) const;
+	// recomputes the tables, keeping the landmarks still on the map and
+	// selecting new ones for those deleted
+	void refresh(const EarthMap &map, unsigned nthreads = 0);
+	// same result as map.distance(); scratch is kept from one query to the
+	// next, one per thread, and settled receives the number of places the
+	// search settled
+	long distance(const EarthMap &map, const std::string &name1, const std::string &name2, SearchScratch &scratch, size_t *settled = nullptr) const;
+	// binary file: "GOSL2\0\0\0", landmark, place and connection counts, a
+	// hash of the connections, selection and requested count as uint64,
+	// landmark then place names as uint64 length and bytes, then the tables
+	// as doubles, all in the byte order of the machine. Places are matched
+	// by name on load, so the map may be renumbered in between, but its
+	// connections must be the same.
+	void save(const std::string &path, const EarthMap &map) const;
+	static Landmarks load(const std::string &path, const EarthMap &map);
+private:
+	Landmarks() {}
+	void build(const EarthMap &map, unsigned nthreads);
+	static size_t farthest(const EarthMap &map, const std::vector<std::vector<double>> &columns, const std::vector<char> &is_landmark, std::mt19937 &rng);
+	static size_t avoid(const EarthMap &map, const std::vector<std::vector<double>> &columns, const std::vector<char> &is_landmark, std::mt19937 &rng);
+};
+
+#endif
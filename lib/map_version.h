@@ -0,0 +1,64 @@
+#ifndef MAP_VERSION_H
+#define MAP_VERSION_H
+
+#include "earth_map.h"
+#include "persistent_vector.h"
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Persistent version of an EarthMap for what-if scenarios. Places and their
+// connections are kept in a PersistentVector, so fork() shares every block
+// with the original and each change copies only the blocks it touches:
+// versions cost memory and time in proportion to their changes, and are
+// queried directly without being rebuilt.
+//
+// The names of the map the first version was built from are shared by all
+// its forks; a fork copies only the names added or deleted since then.
+class MapVersion {
+public:
+	struct Link {
+		uint32_t to;
+		connectionType type;
+		// great-circle length, computed once when the connection is added
+		double length;
+	};
+	struct Site {
+		Place place;
+		std::vector<Link> links;
+		bool deleted;
+	};
+	static const uint32_t npos = UINT32_MAX;
+private:
+	std::shared_ptr<const std::unordered_map<std::string,uint32_t>> base_names;
+	// npos for places of the base deleted since
+	std::map<std::string,uint32_t> changed_names;
+	PersistentVector<Site> sites;
+	size_t place_count;
+public:
+	explicit MapVersion(const EarthMap &map);
+	inline MapVersion fork() const { return *this; }
+	void addPlace(const std::string &name, double latitude, double longitude);
+	void addPlace(const std::string &name, const Spheric<3> &location);
+	void deletePlace(const std::string &name);
+	void addConnection(const std::string &name1, const std::string &name2, connectionType ct);
+	void removeConnection(const std::string &name1, const std::string &name2, connectionType ct);
+	inline size_t getPlaceCount() const { return place_count; }
+	bool hasPlace(const std::string &name) const;
+	// each connection once, not once per direction
+	std::vector<Connection> getConnections() const;
+	// same results as EarthMap::distance on a map with the same changes
+	long distance(const std::string &name1, const std::string &name2) const;
+	std::vector<long> distances(const std::string &source, const std::vector<std::string> &targets) const;
+	// blocks of places, and those of them shared with other
+	inline size_t blockCount() const { return sites.blockCount(); }
+	inline size_t sharedBlocks(const MapVersion &other) const { return sites.sharedBlocks(other.sites); }
+private:
+	uint32_t getId(const std::string &name) const;
+	void link(uint32_t from, uint32_t to, connectionType ct, double length);
+};
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef MEMORY_USAGE_H
+#define MEMORY_USAGE_H
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Bytes used by each structure of a container. Node based containers are
+// estimated from the libstdc++ layout: a red-black tree node carries 32
+// bytes of links and colour, a list node 16 bytes of links, an unordered
+// map node 8 bytes of link plus its bucket, and every heap block 16 bytes
+// of allocator overhead.
+struct MemoryUsage {
+	static const size_t heap_overhead = 16;
+	static const size_t tree_node = 32 + heap_overhead;
+	static const size_t list_node = 16 + heap_overhead;
+	static const size_t hash_node = 8 + heap_overhead;
+	std::vector<std::pair<std::string,size_t>> parts;
+	void add(const std::string &name, size_t bytes);
+	void add(const std::string &prefix, const MemoryUsage &usage);
+	size_t total() const;
+	// heap bytes of a string, 0 while it fits in the object itself
+	static size_t heap(const std::string &s);
+	template <class T>
+	static size_t heap(const std::vector<T> &v) { return v.capacity() * sizeof(T); }
+};
+
+std::ostream& operator<<(std::ostream &out, const MemoryUsage &usage);
+
+#endif
@@ -0,0 +1,155 @@
+#ifndef PERSISTENT_VECTOR_H
+#define PERSISTENT_VECTOR_H
+
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <unordered_set>
+#include <vector>
+
+// Vector whose copies share their storage: values live in leaf blocks of
+// 64 under a tree of fanout 64, copying shares the root and set() or
+// push_back() copy only the blocks on the path to the changed element.
+// Blocks are never modified once shared, so versions can be read from
+// several threads.
+template <class T>
+class PersistentVector {
+	static const unsigned bits = 6;
+	static const size_t width = size_t(1) << bits;
+	struct Block {
+		std::vector<std::shared_ptr<const Block>> children;
+		std::vector<T> values;
+	};
+	std::shared_ptr<const Block> root;
+	// inner levels above the leaves
+	unsigned depth = 0;
+	size_t count = 0;
+public:
+	PersistentVector() {}
+	// builds the blocks in one pass instead of one path copy per element
+	explicit PersistentVector(std::vector<T> values);
+	inline size_t size() const { return count; }
+	inline bool empty() const { return count == 0; }
+	const T& operator[](size_t i) const;
+	const T& at(size_t i) const;
+	void set(size_t i, T value);
+	void push_back(T value);
+	// leaf blocks of this vector, and those of them also used by other
+	size_t blockCount() const;
+	size_t sharedBlocks(const PersistentVector &other) const;
+private:
+	std::shared_ptr<const Block> assign(const std::shared_ptr<const Block> &block, unsigned level, size_t i, T &&value);
+	void leaves(const Block *block, unsigned level, std::vector<const Block*> &res) const;
+};
+
+template <class T>
+PersistentVector<T>::PersistentVector(std::vector<T> values) : count(values.size()) {
+	std::vector<std::shared_ptr<const Block>> level;
+	for (size_t i = 0; i < values.size(); i += width) {
+		std::shared_ptr<Block> block = std::make_shared<Block>();
+		block->values.assign(std::make_move_iterator(values.begin() + i),
+			std::make_move_iterator(values.begin() + std::min(values.size(), i + width)));
+		level.push_back(block);
+	}
+	while (level.size() > 1) {
+		std::vector<std::shared_ptr<const Block>> up;
+		for (size_t i = 0; i < level.size(); i += width) {
+			std::shared_ptr<Block> block = std::make_shared<Block>();
+			block->children.assign(level.begin() + i, level.begin() + std::min(level.size(), i + width));
+			up.push_back(block);
+		}
+		level.swap(up);
+		depth++;
+	}
+	if (!level.empty())
+		root = level.front();
+}
+
+template <class T>
+const T& PersistentVector<T>::operator[](size_t i) const {
+	const Block *block = root.get();
+	for (unsigned level = depth; level > 0; level--)
+		block = block->children[(i >> (bits*level)) & (width-1)].get();
+	return block->values[i & (width-1)];
+}
+
+template <class T>
+const T& PersistentVector<T>::at(size_t i) const {
+	if (i >= count)
+		throw std::out_of_range("PersistentVector::at: index out of range");
+	return (*this)[i];
+}
+
+template <class T>
+void PersistentVector<T>::set(size_t i, T value) {
+	if (i >= count)
+		throw std::out_of_range("PersistentVector::set: index out of range");
+	root = assign(root, depth, i, std::move(value));
+}
+
+template <class T>
+void PersistentVector<T>::push_back(T value) {
+	// full tree, grow a level on top
+	if (count == size_t(1) << (bits*(depth+1))) {
+		std::shared_ptr<Block> top = std::make_shared<Block>();
+		top->children.push_back(root);
+		root = top;
+		depth++;
+	}
+	root = assign(root, depth, count, std::move(value));
+	count++;
+}
+
+template <class T>
+size_t PersistentVector<T>::blockCount() const {
+	std::vector<const Block*> res;
+	leaves(root.get(), depth, res);
+	return res.size();
+}
+
+template <class T>
+size_t PersistentVector<T>::sharedBlocks(const PersistentVector &other) const {
+	std::vector<const Block*> mine, theirs;
+	leaves(root.get(), depth, mine);
+	other.leaves(other.root.get(), other.depth, theirs);
+	std::unordered_set<const Block*> set(theirs.begin(), theirs.end());
+	size_t res = 0;
+	for (const Block *block: mine)
+		res += set.count(block);
+	return res;
+}
+
+template <class T>
+std::shared_ptr<const typename PersistentVector<T>::Block> PersistentVector<T>::assign(const std::shared_ptr<const Block> &block, unsigned level, size_t i, T &&value) {
+	std::shared_ptr<Block> copy = block ? std::make_shared<Block>(*block) : std::make_shared<Block>();
+	if (level == 0) {
+		// elements are only appended at the end, never past it
+		size_t k = i & (width-1);
+		if (k == copy->values.size())
+			copy->values.push_back(std::move(value));
+		else
+			copy->values[k] = std::move(value);
+	}
+	else {
+		size_t k = (i >> (bits*level)) & (width-1);
+		if (k >= copy->children.size())
+			copy->children.resize(k+1);
+		copy->children[k] = assign(copy->children[k], level-1, i, std::move(value));
+	}
+	return copy;
+}
+
+template <class T>
+void PersistentVector<T>::leaves(const Block *block, unsigned level, std::vector<const Block*> &res) const {
+	if (block == nullptr)
+		return;
+	if (level == 0) {
+		res.push_back(block);
+		return;
+	}
+	for (const auto &child: block->children)
+		leaves(child.get(), level-1, res);
+}
+
+#endif
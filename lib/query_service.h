@@ -0,0 +1,41 @@
+#ifndef QUERY_SERVICE_H
+#define QUERY_SERVICE_H
+
+#include "earth_map.h"
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Asynchronous front-end to EarthMap::distance. Requests are queued and
+// picked up by a pool of workers, which group the requests of a batch by
+// source and answer each group with a single one-to-many search.
+// The map must not be modified while the service is running.
+class QueryService {
+	struct Request {
+		std::string from;
+		std::string to;
+		std::promise<long> result;
+	};
+	const EarthMap &map;
+	const size_t capacity;
+	const size_t batch;
+	std::deque<Request> queue;
+	std::mutex mutex;
+	std::condition_variable not_empty;
+	std::condition_variable not_full;
+	bool stopping;
+	std::vector<std::thread> workers;
+public:
+	// distance blocks while capacity requests are waiting (back-pressure)
+	QueryService(const EarthMap &map, unsigned nworkers = 0, size_t capacity = 1024, size_t batch = 64);
+	~QueryService();
+	std::future<long> distance(const std::string &from, const std::string &to);
+private:
+	void work();
+	void answer(std::vector<Request> &requests);
+};
+
+#endif
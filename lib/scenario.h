@@ -2,14 +2,26 @@
 #define SCENARIO_H
 
 #include "earth_map.h"
+#include "map_version.h"
+#include <memory>
 
 class Scenario {
 	EarthMap map;
+	// version of the map at base_revision, forked by fork()
+	mutable std::unique_ptr<MapVersion> base;
+	mutable uint64_t base_revision = 0;
 public:
 	Scenario();
+	// synthetic side x side grid of places "p<i>", see initGrid
+	Scenario(int side, unsigned seed);
 	EarthMap& getMap();
+	// version of the map to try changes on, the map itself is left as is.
+	// Every fork shares the blocks of one base version, which is only
+	// rebuilt after the map changes.
+	MapVersion fork() const;
 private:
 	void initScenario();
+	void initGrid(int side, unsigned seed);
 };
 
 #endif
@@ -0,0 +1,67 @@
+#ifndef SHARDED_ROUTER_H
+#define SHARDED_ROUTER_H
+
+#include "earth_map.h"
+#include <string>
+#include <sys/types.h>
+#include <unordered_map>
+#include <vector>
+
+// Answers distance queries on a map split geographically into shards,
+// each held by its own worker process (the shard_worker executable,
+// reached through a Unix domain socket). Every worker loads only the file
+// of its shard: its places, the connections inside it and those leaving
+// it. The coordinator keeps the shard of each place name and the overlay
+// graph of the boundary places, those with a connection to another
+// shard: connections across shards plus, inside each shard, the distances
+// between its boundary places. A query asks the shards of both ends for
+// their distances to the boundary and searches the overlay in between.
+//
+// Connections are assumed to be the same both ways, as EarthMap builds
+// them. Lengths are summed in another order than by EarthMap::distance(),
+// so a distance may be 1 metre off once truncated.
+class ShardedRouter {
+	struct Shard {
+		pid_t pid;
+		int socket;
+		std::vector<std::string> boundary;
+	};
+	std::vector<Shard> shards;
+	std::unordered_map<std::string,unsigned> shard_of;
+	std::unordered_map<std::string,size_t> overlay_index;
+	std::vector<std::vector<std::pair<size_t,double>>> overlay;
+public:
+	// worker is the path of shard_worker, by default the one next to the
+	// running executable
+	ShardedRouter(const EarthMap &map, unsigned count, const std::string &worker = "");
+	// one worker per shard file written by split()
+	ShardedRouter(const std::vector<std::string> &files, const std::string &worker = "");
+	~ShardedRouter();
+	ShardedRouter(const ShardedRouter&) = delete;
+	ShardedRouter& operator=(const ShardedRouter&) = delete;
+	long distance(const std::string &from, const std::string &to);
+	inline size_t getShardCount() const { return shards.size(); }
+	inline size_t getOverlaySize() const { return overlay.size(); }
+	inline const std::vector<std::string>& getBoundary(unsigned shard) const { return shards.at(shard).boundary; }
+	// writes the count parts of map.partition(count) to directory as
+	// "shard0", "shard1"... and returns their paths. Binary files:
+	// "GOSR1\0\0\0", the places (name, raw coordinates), the connections
+	// inside the shard (both names and type), then those leaving it (local
+	// and remote name, length), each list after its uint64 count and names
+	// as uint32 length and bytes, in the byte order of the machine.
+	static std::vector<std::string> split(const EarthMap &map, unsigned count, const std::string &directory);
+	// body of shard_worker: loads file and answers on socket until the
+	// coordinator closes it
+	static int runWorker(int socket, const std::string &file);
+private:
+	void start(const std::vector<std::string> &files, const std::string &worker);
+	// index of name in the overlay, added to the boundary of shard if new
+	size_t addBoundary(unsigned shard, const std::string &name);
+	// closes the sockets and waits for the workers started so far
+	void stop();
+	void request(unsigned shard, const std::string &source, const std::vector<std::string> &targets);
+	std::vector<double> response(unsigned shard, size_t count);
+	static void serve(int socket, const EarthMap &map, const std::vector<std::pair<std::pair<std::string,std::string>,double>> &cut);
+};
+
+#endif
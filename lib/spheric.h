@@ -3,6 +3,7 @@
 
 #include <algorithm>
 #include <cmath>
+#include <cstdint>
 #include <stdexcept>
 
 template <int N>
@@ -167,6 +168,32 @@ public:
 
 Cartesian convertCartesian(const Spheric<3> &p);
 double distanceGrandCercle(const Spheric<3> &p1, const Spheric<3> &p2);
+// same with latitudes and longitudes in radians
+double distanceGrandCercle(double latitude_1, double longitude_1, double latitude_2, double longitude_2, double radius);
 Spheric<3> coordsEarth(double latitude, double longitude);
+// Cheaper distances, to filter or order candidates before calling
+// distanceGrandCercle. For two points at great-circle distance d on a
+// sphere of radius R (see test_spheric/bench for the measured errors):
+// - distanceChord: straight line, never above d, shorter by at most
+//   d^3/(24 R^2) (1.03 km or 0.10% at 1000 km on the Earth). It grows with d, so it
+//   ranks candidates exactly; compare it with chordLength(d) to filter.
+//   Only cheaper when the Cartesian coordinates are already at hand: the
+//   Spheric overload converts both points and costs about as much as
+//   distanceGrandCercle.
+// - distanceEquirectangular: flat projection at the mean latitude, within
+//   0.01% of d below 100 km and 1% below 1000 km between latitudes -70
+//   and 70 degrees, unbounded beyond.
+// - distanceGrandCercleFast: haversine with polynomial sine and arcsine,
+//   within 1e-5 relative or 1 mm absolute of d everywhere.
+double distanceChord(const Cartesian &c1, const Cartesian &c2);
+double distanceChord(const Spheric<3> &p1, const Spheric<3> &p2);
+double chordLength(double distance, double radius);
+double distanceEquirectangular(const Spheric<3> &p1, const Spheric<3> &p2);
+double distanceEquirectangular(double latitude_1, double longitude_1, double latitude_2, double longitude_2, double radius);
+double distanceGrandCercleFast(const Spheric<3> &p1, const Spheric<3> &p2);
+double distanceGrandCercleFast(double latitude_1, double longitude_1, double latitude_2, double longitude_2, double radius);
+// Z-order key of a point inside the ball of the given radius (21 bits per axis),
+// close keys are close points
+uint64_t mortonCode(const Cartesian &c, double radius);
 
 #endif
@@ -0,0 +1,6 @@
+#ifndef TEST_EARTH_MAP_H
+#define TEST_EARTH_MAP_H
+
+void testEarthMap();
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef UNION_FIND_H
+#define UNION_FIND_H
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// Disjoint sets over 0..size()-1. find and unite may be called concurrently;
+// add and assign may not. The root of a set is always its smallest element.
+class UnionFind {
+	std::unique_ptr<std::atomic<size_t>[]> _parent;
+	size_t _size;
+	size_t _capacity;
+public:
+	UnionFind(size_t size = 0);
+	UnionFind(UnionFind &&uf) = default;
+	UnionFind& operator=(UnionFind &&uf) = default;
+	inline size_t size() const { return _size; }
+	inline size_t capacity() const { return _capacity; }
+	size_t add();
+	void assign(const std::vector<size_t> &roots);
+	size_t find(size_t i);
+	bool unite(size_t a, size_t b);
+	bool same(size_t a, size_t b);
+};
+
+#endif
@@ -0,0 +1,323 @@
+#include "graph.h"
+#include "scenario.h"
+#include "landmarks.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+typedef std::chrono::steady_clock Clock;
+
+// side x side grid, every node linked both ways to its right and lower neighbours
+void buildGrid(Graph<int,int> &g, int side) {
+	std::vector<const Node<int>*> n;
+	for (int i = 0; i < side*side; i++)
+		n.push_back(g.addNode(i));
+	for (int i = 0; i < side; i++) {
+		for (int j = 0; j < side; j++) {
+			if (j < side-1) {
+				g.addEdge(0, n[i*side+j], n[i*side+j+1]);
+				g.addEdge(0, n[i*side+j+1], n[i*side+j]);
+			}
+			if (i < side-1) {
+				g.addEdge(0, n[i*side+j], n[(i+1)*side+j]);
+				g.addEdge(0, n[(i+1)*side+j], n[i*side+j]);
+			}
+		}
+	}
+}
+
+struct _bench_count {
+	std::atomic<size_t> *count;
+	void operator()(const Node<int> *, unsigned) {
+		count->fetch_add(1, std::memory_order_relaxed);
+	}
+};
+
+struct _bench_serial_count {
+	size_t count = 0;
+	const Node<int>* operator()(const Node<int> *, const Node<int> *, const Edge<int> *) {
+		count++;
+		return nullptr;
+	}
+};
+
+void benchBreadthFirst(int side, int repeat) {
+	Graph<int,int> g;
+	buildGrid(g, side);
+	g.getAdjacency();
+	const Node<int> *start = g.getNodes().front();
+	std::cout << "breadth first, " << side*side << " nodes, "
+		<< g.getEdges().size() << " edges" << std::endl;
+
+	Clock::time_point t0 = Clock::now();
+	for (int r = 0; r < repeat; r++)
+		g.breadthFirst(start, _bench_serial_count());
+	double serial = std::chrono::duration<double>(Clock::now() - t0).count() / repeat;
+	std::cout << "  serial      " << serial*1000 << " ms" << std::endl;
+
+	unsigned max_threads = std::max(1u, std::thread::hardware_concurrency());
+	double base = 0;
+	for (unsigned threads = 1; threads <= max_threads; threads *= 2) {
+		std::atomic<size_t> count(0);
+		t0 = Clock::now();
+		for (int r = 0; r < repeat; r++)
+			g.parallelBreadthFirst(start, _bench_count{&count}, threads);
+		double t = std::chrono::duration<double>(Clock::now() - t0).count() / repeat;
+		if (threads == 1)
+			base = t;
+		std::cout << "  " << threads << " thread(s) " << t*1000 << " ms, speedup "
+			<< base/t << ", " << count/repeat << " nodes" << std::endl;
+		if (threads < max_threads && threads*2 > max_threads)
+			threads = max_threads / 2;
+	}
+}
+
+// hardware cache misses of the calling thread, when the kernel lets us count them
+class CacheMisses {
+	int fd;
+public:
+	CacheMisses() : fd(-1) {
+#ifdef __linux__
+		struct perf_event_attr attr;
+		std::memset(&attr, 0, sizeof(attr));
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.size = sizeof(attr);
+		attr.config = PERF_COUNT_HW_CACHE_MISSES;
+		attr.disabled = 1;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+	}
+	~CacheMisses() {
+#ifdef __linux__
+		if (fd >= 0)
+			close(fd);
+#endif
+	}
+	bool available() const { return fd >= 0; }
+	void start() {
+#ifdef __linux__
+		if (fd >= 0) {
+			ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+			ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+		}
+#endif
+	}
+	long long stop() {
+		long long count = -1;
+#ifdef __linux__
+		if (fd >= 0) {
+			ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+			if (read(fd, &count, sizeof(count)) != sizeof(count))
+				count = -1;
+		}
+#endif
+		return count;
+	}
+};
+
+void benchRouting(int side, int queries) {
+	std::mt19937 rng(42);
+	Scenario scenario(side, 42);
+	EarthMap &map = scenario.getMap();
+	std::uniform_int_distribution<int> pick(0, side*side-1);
+	std::vector<std::pair<std::string,std::string>> pairs;
+	for (int q = 0; q < queries; q++)
+		pairs.push_back(std::make_pair("p" + std::to_string(pick(rng)), "p" + std::to_string(pick(rng))));
+	std::cout << "routing, " << side*side << " places, " << queries << " queries" << std::endl;
+
+	const char *layouts[] = {"insertion", "morton", "cuthill-mckee"};
+	CacheMisses misses;
+	for (int layout = 0; layout < 3; layout++) {
+		if (layout == 1)
+			map.reorderPlaces(MORTON);
+		else if (layout == 2)
+			map.reorderPlaces(CUTHILL_MCKEE);
+		long checksum = 0;
+		map.distance(pairs[0].first, pairs[0].second);
+		misses.start();
+		Clock::time_point t0 = Clock::now();
+		for (auto &p: pairs)
+			checksum += map.distance(p.first, p.second);
+		double t = std::chrono::duration<double>(Clock::now() - t0).count();
+		long long count = misses.stop();
+		std::cout << "  " << layouts[layout] << ": " << queries/t << " queries/s, ";
+		if (misses.available())
+			std::cout << count/queries << " cache misses/query";
+		else
+			std::cout << "cache misses n/a";
+		std::cout << " (checksum " << checksum << ")" << std::endl;
+	}
+}
+
+void benchDistanceMatrix(int side, int count) {
+	Scenario scenario(side, 42);
+	const EarthMap &map = scenario.getMap();
+	std::mt19937 rng(7);
+	std::uniform_int_distribution<int> pick(0, side*side-1);
+	std::vector<std::string> names;
+	for (int i = 0; i < count; i++)
+		names.push_back("p" + std::to_string(pick(rng)));
+	std::cout << "distance matrix, " << side*side << " places, "
+		<< count << "x" << count << std::endl;
+
+	Clock::time_point t0 = Clock::now();
+	long checksum = 0;
+	for (const std::string &from: names)
+		for (const std::string &to: names)
+			checksum += map.distance(from, to);
+	double t = std::chrono::duration<double>(Clock::now() - t0).count();
+	std::cout << "  distance loop " << t*1000 << " ms (checksum " << checksum << ")" << std::endl;
+
+	unsigned max_threads = std::max(1u, std::thread::hardware_concurrency());
+	t0 = Clock::now();
+	DistanceMatrix m = map.distanceMatrix(names, names, max_threads);
+	t = std::chrono::duration<double>(Clock::now() - t0).count();
+	checksum = 0;
+	for (size_t i = 0; i < m.rows(); i++)
+		for (size_t j = 0; j < m.cols(); j++)
+			checksum += m(i, j);
+	std::cout << "  matrix, " << max_threads << " thread(s) " << t*1000 << " ms (checksum " << checksum << ")" << std::endl;
+}
+
+void benchIsochrones(int side, int count, long budget) {
+	Scenario scenario(side, 42);
+	const EarthMap &map = scenario.getMap();
+	std::mt19937 rng(11);
+	std::uniform_int_distribution<int> pick(0, side*side-1);
+	std::vector<std::string> origins;
+	for (int i = 0; i < count; i++)
+		origins.push_back("p" + std::to_string(pick(rng)));
+	std::cout << "isochrones, " << side*side << " places, " << count
+		<< " origins, budget " << budget/1000 << " km" << std::endl;
+
+	SearchScratch scratch;
+	Clock::time_point t0 = Clock::now();
+	size_t reached = 0;
+	for (const std::string &origin: origins)
+		reached += map.isochrone(origin, budget, scratch).size();
+	double t = std::chrono::duration<double>(Clock::now() - t0).count();
+	std::cout << "  sequential " << t*1000 << " ms (" << reached << " places)" << std::endl;
+
+	unsigned max_threads = std::max(1u, std::thread::hardware_concurrency());
+	t0 = Clock::now();
+	reached = 0;
+	for (const auto &iso: map.isochrones(origins, budget, max_threads))
+		reached += iso.size();
+	t = std::chrono::duration<double>(Clock::now() - t0).count();
+	std::cout << "  batch, " << max_threads << " thread(s) " << t*1000 << " ms (" << reached << " places)" << std::endl;
+}
+
+void benchLandmarks(int side, int queries, unsigned count) {
+	Scenario scenario(side, 42);
+	EarthMap &map = scenario.getMap();
+	// a wall with a single gap at the west end, routes across it detour
+	for (int j = 1; j < side; j++)
+		map.removeConnection("p" + std::to_string((side/2 - 1)*side + j), "p" + std::to_string(side/2*side + j), TRAIN);
+	std::mt19937 rng(5);
+	std::uniform_int_distribution<int> row(0, side/2 - 1), col(0, side-1);
+	std::vector<std::pair<std::string,std::string>> pairs;
+	for (int i = 0; i < queries; i++)
+		pairs.push_back(std::make_pair("p" + std::to_string(row(rng)*side + col(rng)),
+			"p" + std::to_string((side/2 + row(rng))*side + col(rng))));
+	std::cout << "landmarks, " << side*side << " places, " << queries << " queries across a wall" << std::endl;
+
+	unsigned max_threads = std::max(1u, std::thread::hardware_concurrency());
+	Clock::time_point t0 = Clock::now();
+	Landmarks none(map, 0), alt(map, count, AVOID, max_threads);
+	double t = std::chrono::duration<double>(Clock::now() - t0).count();
+	std::cout << "  " << count << " landmarks in " << t*1000 << " ms" << std::endl;
+	SearchScratch scratch;
+	for (const Landmarks *landmarks: {&none, &alt}) {
+		size_t settled = 0, n;
+		long checksum = 0;
+		t0 = Clock::now();
+		for (auto &p: pairs) {
+			checksum += landmarks->distance(map, p.first, p.second, scratch, &n);
+			settled += n;
+		}
+		t = std::chrono::duration<double>(Clock::now() - t0).count();
+		std::cout << "  " << (landmarks == &none ? "great circle" : "ALT") << " " << t*1000 << " ms, "
+			<< settled / queries << " places settled per query (checksum " << checksum << ")" << std::endl;
+	}
+}
+
+void benchMemory(int side) {
+	Scenario scenario(side, 42);
+	const EarthMap &map = scenario.getMap();
+	map.reachable("p0", "p1");
+	std::cout << "memory, " << side*side << " places" << std::endl;
+	std::cout << map.memoryUsage();
+	std::cout << "compact" << std::endl << map.compact().memoryUsage();
+}
+
+// accuracy and cost of the cheaper distances against distanceGrandCercle,
+// on pairs of places at most spread degrees apart
+void benchApproximations(double spread, int count) {
+	std::mt19937 rng(3);
+	std::uniform_real_distribution<double> latitude(-70, 70), longitude(-180, 180), delta(-spread, spread);
+	std::vector<Spheric<3>> p1, p2;
+	std::vector<Cartesian> c1, c2;
+	for (int i = 0; i < count; i++) {
+		double la = latitude(rng), lo = longitude(rng);
+		double lb = std::max(-89.0, std::min(89.0, la + delta(rng)));
+		double lob = lo + delta(rng);
+		lob -= 360 * std::floor((lob + 180) / 360);
+		p1.push_back(coordsEarth(la, lo));
+		p2.push_back(coordsEarth(lb, lob));
+		c1.push_back(convertCartesian(p1.back()));
+		c2.push_back(convertCartesian(p2.back()));
+	}
+	std::vector<double> exact(count);
+	std::cout << "distance approximations, " << count << " pairs within " << spread << " degrees" << std::endl;
+	auto run = [&](const char *name, std::function<double(int)> fn) {
+		double checksum = 0, worst = 0;
+		Clock::time_point t0 = Clock::now();
+		for (int i = 0; i < count; i++)
+			checksum += fn(i);
+		double t = std::chrono::duration<double>(Clock::now() - t0).count();
+		for (int i = 0; i < count; i++)
+			if (exact[i] > 1)
+				worst = std::max(worst, std::abs(fn(i) - exact[i]) / exact[i]);
+		std::cout << "  " << name << " " << t / count * 1e9 << " ns, max relative error "
+			<< worst << " (checksum " << checksum << ")" << std::endl;
+	};
+	for (int i = 0; i < count; i++)
+		exact[i] = distanceGrandCercle(p1[i], p2[i]);
+	run("haversine      ", [&](int i) { return distanceGrandCercle(p1[i], p2[i]); });
+	run("fast haversine ", [&](int i) { return distanceGrandCercleFast(p1[i], p2[i]); });
+	run("equirectangular", [&](int i) { return distanceEquirectangular(p1[i], p2[i]); });
+	// Place only stores Spheric<3>: the first chord converts both points on
+	// every call, the second reuses Cartesians converted beforehand
+	run("chord, spheric ", [&](int i) { return distanceChord(p1[i], p2[i]); });
+	run("chord, cached  ", [&](int i) { return distanceChord(c1[i], c2[i]); });
+}
+
+// timings are only meaningful with -DCMAKE_BUILD_TYPE=Release
+int main(int argc, char *argv[]) {
+	int side = argc > 1 ? std::atoi(argv[1]) : 100;
+	int repeat = argc > 2 ? std::atoi(argv[2]) : 10;
+	benchBreadthFirst(side, repeat);
+	benchRouting(side/2, 20*repeat);
+	benchDistanceMatrix(side/2, 4*repeat);
+	benchIsochrones(side/2, 20*repeat, 500000);
+	benchLandmarks(side/2, 10*repeat, 8);
+	benchMemory(side/2);
+	benchApproximations(1, 100000*repeat);
+	benchApproximations(10, 100000*repeat);
+	return 0;
+}
@@ -0,0 +1,103 @@
+#include "compact_map.h"
+#include "earth_map.h"
+
+#include <algorithm>
+#include <functional>
+#include <queue>
+
+static int32_t quantize(double radians) {
+	return std::lround(radians * 180 / M_PI / CompactMap::resolution);
+}
+
+CompactMap::CompactMap(const EarthMap &map) : radius(0) {
+	const Adjacency<Place,connectionType> &adj = map.getAdjacency();
+	const size_t n = adj.nodes.size();
+	if (n >= npos || adj.out_targets.size() >= npos)
+		throw std::length_error("CompactMap::CompactMap: map is too large for 32-bit ids");
+	latitudes.reserve(n);
+	longitudes.reserve(n);
+	name_offsets.reserve(n + 1);
+	name_offsets.push_back(0);
+	for (size_t i = 0; i < n; i++) {
+		const Place &place = adj.nodes[i]->getData();
+		const Spheric<3> &location = place.getLocation();
+		if (i == 0)
+			radius = std::abs(location.getRadius());
+		else if (radius != std::abs(location.getRadius()))
+			throw std::invalid_argument("CompactMap::CompactMap: places are not on the same sphere");
+		// back to true latitude and longitude, whatever the sign of the radius
+		Cartesian c = convertCartesian(location);
+		latitudes.push_back(quantize(std::asin(std::max(-1.0, std::min(1.0, c.z / radius)))));
+		longitudes.push_back(quantize(std::atan2(c.y, c.x)));
+		names += place.getName();
+		name_offsets.push_back(names.size());
+	}
+	by_name.resize(n);
+	for (uint32_t i = 0; i < n; i++)
+		by_name[i] = i;
+	std::sort(by_name.begin(), by_name.end(), [this](uint32_t a, uint32_t b) {
+		return getName(a) < getName(b);
+	});
+	offsets.assign(adj.out_offsets.begin(), adj.out_offsets.end());
+	targets.assign(adj.out_targets.begin(), adj.out_targets.end());
+	names.shrink_to_fit();
+}
+
+std::string CompactMap::getName(uint32_t id) const {
+	return names.substr(name_offsets.at(id), name_offsets.at(id+1) - name_offsets.at(id));
+}
+
+uint32_t CompactMap::getId(const std::string &name) const {
+	auto it = std::lower_bound(by_name.begin(), by_name.end(), name, [this](uint32_t id, const std::string &name) {
+		return names.compare(name_offsets[id], name_offsets[id+1] - name_offsets[id], name) < 0;
+	});
+	if (it == by_name.end() || names.compare(name_offsets[*it], name_offsets[*it+1] - name_offsets[*it], name) != 0)
+		return npos;
+	return *it;
+}
+
+double CompactMap::getLatitude(uint32_t id) const {
+	return latitudes.at(id) * resolution * M_PI / 180;
+}
+
+double CompactMap::getLongitude(uint32_t id) const {
+	return longitudes.at(id) * resolution * M_PI / 180;
+}
+
+long CompactMap::distance(const std::string &name1, const std::string &name2) const {
+	uint32_t source = getId(name1), goal = getId(name2);
+	if (source == npos || goal == npos)
+		return -1;
+	std::vector<double> dist(size(), INFINITY);
+	typedef std::pair<double,uint32_t> Entry;
+	std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;
+	dist[source] = 0;
+	queue.push(Entry(0, source));
+	while (!queue.empty()) {
+		Entry e = queue.top();
+		queue.pop();
+		uint32_t u = e.second;
+		if (u == goal)
+			return e.first;
+		if (e.first > dist[u])
+			continue;
+		for (uint32_t k = offsets[u]; k < offsets[u+1]; k++) {
+			uint32_t v = targets[k];
+			double d = dist[u] + distanceGrandCercle(getLatitude(u), getLongitude(u),
+					getLatitude(v), getLongitude(v), radius);
+			if (d < dist[v]) {
+				dist[v] = d;
+				queue.push(Entry(d, v));
+			}
+		}
+	}
+	return -1;
+}
+
+MemoryUsage CompactMap::memoryUsage() const {
+	MemoryUsage usage;
+	usage.add("coordinates", MemoryUsage::heap(latitudes) + MemoryUsage::heap(longitudes));
+	usage.add("names", names.capacity() + MemoryUsage::heap(name_offsets) + MemoryUsage::heap(by_name));
+	usage.add("connections", MemoryUsage::heap(offsets) + MemoryUsage::heap(targets));
+	return usage;
+}
@@ -0,0 +1,60 @@
+#include "distance_matrix.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <new>
+#include <stdexcept>
+
+static const char magic[8] = {'G', 'O', 'S', 'D', 'M', '1', 0, 0};
+
+void DistanceMatrix::Free::operator()(int64_t *p) const {
+	::operator delete(p, std::align_val_t(alignment));
+}
+
+DistanceMatrix::DistanceMatrix(size_t rows, size_t cols) : _rows(rows), _cols(cols) {
+	const size_t per_line = alignment / sizeof(int64_t);
+	_stride = (cols + per_line - 1) / per_line * per_line;
+	size_t bytes = std::max<size_t>(1, _rows * _stride) * sizeof(int64_t);
+	_data.reset(static_cast<int64_t*>(::operator new(bytes, std::align_val_t(alignment))));
+	std::fill(_data.get(), _data.get() + _rows * _stride, -1);
+}
+
+void DistanceMatrix::save(const std::string &path) const {
+	std::ofstream out(path, std::ios::binary);
+	if (!out)
+		throw std::runtime_error("DistanceMatrix::save: cannot open " + path);
+	uint64_t header[2] = {_rows, _cols};
+	out.write(magic, sizeof(magic));
+	out.write(reinterpret_cast<const char*>(header), sizeof(header));
+	for (size_t i = 0; i < _rows; i++)
+		out.write(reinterpret_cast<const char*>(row(i)), _cols * sizeof(int64_t));
+	if (!out)
+		throw std::runtime_error("DistanceMatrix::save: cannot write " + path);
+}
+
+DistanceMatrix DistanceMatrix::load(const std::string &path) {
+	std::ifstream in(path, std::ios::binary);
+	char buffer[sizeof(magic)];
+	uint64_t header[2];
+	in.read(buffer, sizeof(buffer));
+	in.read(reinterpret_cast<char*>(header), sizeof(header));
+	if (!in || std::memcmp(buffer, magic, sizeof(magic)) != 0)
+		throw std::runtime_error("DistanceMatrix::load: not a distance matrix " + path);
+	// the header must account for the rest of the file before anything is
+	// allocated, without overflowing on a corrupt one
+	std::streamoff start = in.tellg();
+	in.seekg(0, std::ios::end);
+	uint64_t remaining = in.tellg() - start;
+	in.seekg(start);
+	const uint64_t rows = header[0], cols = header[1];
+	if (remaining % sizeof(int64_t) != 0 || (cols == 0 ? remaining != 0 :
+		rows > remaining / sizeof(int64_t) / cols || rows * cols != remaining / sizeof(int64_t)))
+		throw std::runtime_error("DistanceMatrix::load: size does not match the header " + path);
+	DistanceMatrix m(rows, cols);
+	for (size_t i = 0; i < m._rows && m._cols > 0; i++)
+		in.read(reinterpret_cast<char*>(m.row(i)), m._cols * sizeof(int64_t));
+	if (!in)
+		throw std::runtime_error("DistanceMatrix::load: truncated file " + path);
+	return m;
+}
@@ -1,16 +1,18 @@
 #include "earth_map.h"
 
-#include <climits>
+#include <cmath>
+#include <functional>
+#include <queue>
 
 Place::Place(std::string name, Spheric<3> location) :
-	_name(name), _location(location) {}
+	_name(std::move(name)), _location(location) {}
 
 bool Place::operator==(const Place& p) {
 	return _name == p._name;
 
 }
 
-const Node<Place>* EarthMap::getPlace(const std::string &name) {
+const Node<Place>* EarthMap::getPlace(const std::string &name) const {
 	try {
 		return places.at(name);
 	}
@@ -20,12 +22,21 @@ const Node<Place>* EarthMap::getPlace(const std::string &name) {
 }
 
 void EarthMap::addPlace(const std::string &name, double latitude, double longitude) {
+	addPlace(name, coordsEarth(latitude, longitude));
+}
+
+void EarthMap::addPlace(const std::string &name, const Spheric<3> &location) {
 	auto it = getPlace(name);
 	if (it == nullptr) {
-		Spheric<3> location = coordsEarth(latitude, longitude);
-		Place p = Place(name, location);
-		const Node<Place> *n = addNode(p);
-		places[name] = n;
+		const Node<Place> *n = emplaceNode(name, location);
+		places.emplace(name, n);
+		revision++;
+		std::lock_guard<std::mutex> lock(reachability.mutex);
+		if (reachability.valid) {
+			reachability.ids[n] = reachability.any.add();
+			for (auto &uf: reachability.by_type)
+				uf.second.add();
+		}
 	}
 }
 void EarthMap::deletePlace(const std::string &name) {
@@ -33,6 +44,9 @@ void EarthMap::deletePlace(const std::string &name) {
 	if (it != nullptr) {
 		deleteNode(it);
 		places.erase(name);
+		revision++;
+		std::lock_guard<std::mutex> lock(reachability.mutex);
+		reachability.valid = false;
 	}
 }
 
@@ -42,6 +56,13 @@ void EarthMap::addConnection(const std::string &name1, const std::string &name2,
 	if (it1 != nullptr || it2 != nullptr) {
 		addEdge(ct, it1, it2);
 		addEdge(ct, it2, it1);
+		revision++;
+		std::lock_guard<std::mutex> lock(reachability.mutex);
+		if (reachability.valid) {
+			size_t id1 = reachability.ids.at(it1), id2 = reachability.ids.at(it2);
+			reachability.any.unite(id1, id2);
+			reachability.by_type.at(ct).unite(id1, id2);
+		}
 	}
 }
 void EarthMap::removeConnection(std::string name1, std::string name2, connectionType ct) {
@@ -50,50 +71,354 @@ void EarthMap::removeConnection(std::string name1, std::string name2, connection
 	if (it1 != nullptr || it2 != nullptr) {
 		deleteEdge(ct, it1, it2);
 		deleteEdge(ct, it2, it1);
+		revision++;
+		std::lock_guard<std::mutex> lock(reachability.mutex);
+		reachability.valid = false;
 	}
 
 }
-struct _distance {
-	std::map<const Node<Place>*,long> distances;
-	const Node<Place> *goal;
-	const Node<Place>* operator()(const Node<Place> *from, const Node<Place> *to, const Edge<connectionType> *edge) {
-		edge->getAnnotation();
-		long val = LONG_MAX;
-		try {
-			long val = distances.at(from) + distanceGrandCercle(from->getData().getLocation(), to->getData().getLocation());
+long EarthMap::distance(const std::string &name1, const std::string &name2) const {
+	return distances(name1, std::vector<std::string>(1, name2)).front();
+}
+
+std::vector<long> EarthMap::distances(const std::string &source, const std::vector<std::string> &targets) const {
+	std::vector<long> res(targets.size(), -1);
+	const Node<Place> *n1 = getPlace(source);
+	if (n1 == nullptr)
+		return res;
+	const Adjacency<Place,connectionType> &adj = getAdjacency();
+	std::vector<size_t> goals;
+	for (const std::string &name: targets) {
+		const Node<Place> *n2 = getPlace(name);
+		// no route, skip the search
+		if (n2 != nullptr && reachable(n1, n2, nullptr))
+			goals.push_back(adj.index.at(n2));
+	}
+	if (goals.empty())
+		return res;
+	std::vector<double> dist;
+	shortestPaths(adj.index.at(n1), goals, dist);
+	for (size_t i = 0; i < targets.size(); i++) {
+		const Node<Place> *n2 = getPlace(targets[i]);
+		if (n2 != nullptr && dist[adj.index.at(n2)] != INFINITY)
+			res[i] = dist[adj.index.at(n2)];
+	}
+	return res;
+}
+
+DistanceMatrix EarthMap::distanceMatrix(const std::vector<std::string> &sources, const std::vector<std::string> &targets, unsigned nthreads) const {
+	DistanceMatrix matrix(sources.size(), targets.size());
+	const Adjacency<Place,connectionType> &adj = getAdjacency();
+	const size_t none = adj.nodes.size();
+	auto ids = [this, &adj, none](const std::vector<std::string> &names) {
+		std::vector<size_t> res;
+		for (const std::string &name: names) {
+			const Node<Place> *n = getPlace(name);
+			res.push_back(n == nullptr ? none : adj.index.at(n));
 		}
-		catch (std::out_of_range e) {
-			// part of the route contains an edge with different connectionType
+		return res;
+	};
+	std::vector<size_t> source_ids = ids(sources), target_ids = ids(targets);
+	// search from the smaller side, each search fills a row or a column
+	const bool backward = targets.size() < sources.size();
+	const std::vector<size_t> &from = backward ? target_ids : source_ids;
+	std::vector<size_t> to = backward ? source_ids : target_ids;
+	to.erase(std::remove(to.begin(), to.end(), none), to.end());
+	if (to.empty())
+		return matrix;
+	parallelFor(from.size(), nthreads, [&](unsigned, size_t begin, size_t end) {
+		std::vector<double> dist;
+		for (size_t i = begin; i < end; i++) {
+			if (from[i] == none)
+				continue;
+			shortestPaths(from[i], to, dist, backward);
+			const std::vector<size_t> &other = backward ? source_ids : target_ids;
+			for (size_t j = 0; j < other.size(); j++) {
+				if (other[j] == none || dist[other[j]] == INFINITY)
+					continue;
+				if (backward)
+					matrix(j, i) = dist[other[j]];
+				else
+					matrix(i, j) = dist[other[j]];
+			}
 		}
-		// update distance to 'to'
-		try {
-			long& d = distances.at(to);
-			d = std::min(d, val);
+	});
+	return matrix;
+}
+
+void EarthMap::shortestPaths(size_t source, const std::vector<size_t> &targets, std::vector<double> &dist, bool backward,
+		std::vector<size_t> *parent, std::vector<size_t> *order) const {
+	const Adjacency<Place,connectionType> &adj = getAdjacency();
+	const std::vector<size_t> &offsets = backward ? adj.in_offsets : adj.out_offsets;
+	const std::vector<size_t> &next = backward ? adj.in_sources : adj.out_targets;
+	const std::vector<Spheric<3>> &locations = getLocations();
+	const size_t n = adj.nodes.size();
+	dist.assign(n, INFINITY);
+	std::vector<char> settled(n, 0);
+	std::vector<char> goal(n, 0);
+	size_t remaining = 0;
+	for (size_t t: targets) {
+		if (!goal[t])
+			remaining++;
+		goal[t] = 1;
+	}
+	const bool everywhere = targets.empty();
+	if (parent != nullptr)
+		parent->assign(n, n);
+	if (order != nullptr)
+		order->clear();
+	typedef std::pair<double,size_t> Entry;
+	std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;
+	dist[source] = 0;
+	queue.push(Entry(0, source));
+	while (!queue.empty() && (everywhere || remaining > 0)) {
+		size_t u = queue.top().second;
+		queue.pop();
+		if (settled[u])
+			continue;
+		settled[u] = 1;
+		if (order != nullptr)
+			order->push_back(u);
+		if (goal[u])
+			remaining--;
+		const Spheric<3> &from = locations[u];
+		for (size_t k = offsets[u]; k < offsets[u+1]; k++) {
+			size_t v = next[k];
+			double d = dist[u] + distanceGrandCercle(from, locations[v]);
+			if (d < dist[v]) {
+				dist[v] = d;
+				if (parent != nullptr)
+					(*parent)[v] = u;
+				queue.push(Entry(d, v));
+			}
 		}
-		catch (std::out_of_range e) {
-			// first visit
-			distances[to] = val;
+	}
+}
+
+void SearchScratch::reset(size_t size) {
+	// two stamps per search, cleared before round + 1 wraps to 0
+	if (dist.size() != size || round >= UINT32_MAX - 2) {
+		dist.assign(size, INFINITY);
+		stamp.assign(size, 0);
+		round = 1;
+	}
+	else {
+		round += 2;
+	}
+	heap.clear();
+}
+
+std::vector<std::pair<std::string,long>> EarthMap::isochrone(const std::string &name, long budget, SearchScratch &scratch) const {
+	return isochrone(getPlace(name), budget, nullptr, scratch);
+}
+
+std::vector<std::pair<std::string,long>> EarthMap::isochrone(const std::string &name, long budget, connectionType ct, SearchScratch &scratch) const {
+	return isochrone(getPlace(name), budget, &ct, scratch);
+}
+
+std::vector<std::vector<std::pair<std::string,long>>> EarthMap::isochrones(const std::vector<std::string> &origins, long budget, unsigned nthreads) const {
+	return isochrones(origins, budget, nullptr, nthreads);
+}
+
+std::vector<std::vector<std::pair<std::string,long>>> EarthMap::isochrones(const std::vector<std::string> &origins, long budget, connectionType ct, unsigned nthreads) const {
+	return isochrones(origins, budget, &ct, nthreads);
+}
+
+std::vector<std::vector<std::pair<std::string,long>>> EarthMap::isochrones(const std::vector<std::string> &origins, long budget, const connectionType *ct, unsigned nthreads) const {
+	std::vector<std::vector<std::pair<std::string,long>>> res(origins.size());
+	getAdjacency();
+	parallelFor(origins.size(), nthreads, [&](unsigned, size_t begin, size_t end) {
+		SearchScratch scratch;
+		for (size_t i = begin; i < end; i++)
+			res[i] = isochrone(getPlace(origins[i]), budget, ct, scratch);
+	});
+	return res;
+}
+
+std::vector<std::pair<std::string,long>> EarthMap::isochrone(const Node<Place> *origin, long budget, const connectionType *ct, SearchScratch &scratch) const {
+	std::vector<std::pair<std::string,long>> res;
+	if (origin == nullptr || budget < 0)
+		return res;
+	const Adjacency<Place,connectionType> &adj = getAdjacency();
+	const std::vector<Spheric<3>> &locations = getLocations();
+	// distances are truncated like distance() does: d is within the budget
+	// while d < budget + 1, computed in double so that LONG_MAX cannot overflow
+	const double limit = (double) budget + 1;
+	scratch.reset(adj.nodes.size());
+	std::vector<double> &dist = scratch.dist;
+	std::vector<uint32_t> &stamp = scratch.stamp;
+	const uint32_t round = scratch.round;
+	auto &heap = scratch.heap;
+	// min-heap on distance
+	auto later = [](const std::pair<double,size_t> &a, const std::pair<double,size_t> &b) {
+		return a.first > b.first;
+	};
+	size_t source = adj.index.at(origin);
+	dist[source] = 0;
+	stamp[source] = round;
+	heap.push_back(std::make_pair(0.0, source));
+	while (!heap.empty()) {
+		std::pop_heap(heap.begin(), heap.end(), later);
+		std::pair<double,size_t> top = heap.back();
+		heap.pop_back();
+		size_t u = top.second;
+		if (top.first > dist[u])
+			continue;
+		// everything left is farther
+		if (top.first >= limit)
+			break;
+		res.push_back(std::make_pair(adj.nodes[u]->getData().getName(), (long) top.first));
+		const Spheric<3> &from = locations[u];
+		for (size_t k = adj.out_offsets[u]; k < adj.out_offsets[u+1]; k++) {
+			if (ct != nullptr && adj.out_edges[k]->getAnnotation() != *ct)
+				continue;
+			size_t v = adj.out_targets[k];
+			double d = top.first + distanceGrandCercle(from, locations[v]);
+			if (d >= limit)
+				continue;
+			if (stamp[v] != round || d < dist[v]) {
+				stamp[v] = round;
+				dist[v] = d;
+				heap.push_back(std::make_pair(d, v));
+				std::push_heap(heap.begin(), heap.end(), later);
+			}
 		}
-		// if hit the goal then end
-		if (from == goal)
-			return goal;
-		// continue
-		return nullptr;
 	}
-};
+	return res;
+}
 
-long EarthMap::distance(const std::string &name1, const std::string &name2) {
-	struct _distance d;
-	const Node<Place> *n1 = getPlace(name1);
-	const Node<Place> *n2 = getPlace(name2);
-	d.distances[n1] = 0;
-	d.goal = n2;
-	breadthFirst(n1, d);
-	try {
-		return d.distances.at(n2);
+void EarthMap::reorderPlaces(placeOrder order) {
+	revision++;
+	if (order == CUTHILL_MCKEE) {
+		reorder(reverseCuthillMcKee());
+		return;
 	}
-	catch (std::out_of_range e) {
-		return -1; // error
+	reorder(mortonOrder());
+}
+
+std::vector<size_t> EarthMap::mortonOrder() const {
+	const std::vector<Node<Place>*> &nodes = getNodes();
+	std::vector<std::pair<uint64_t,size_t>> keys;
+	keys.reserve(nodes.size());
+	for (size_t i = 0; i < nodes.size(); i++) {
+		const Spheric<3> &location = nodes[i]->getData().getLocation();
+		keys.push_back(std::make_pair(mortonCode(convertCartesian(location), location.getRadius()), i));
+	}
+	std::sort(keys.begin(), keys.end());
+	std::vector<size_t> order;
+	order.reserve(keys.size());
+	for (auto &key: keys)
+		order.push_back(key.second);
+	return order;
+}
+
+std::vector<std::vector<std::string>> EarthMap::partition(unsigned count) const {
+	if (count == 0)
+		throw std::invalid_argument("EarthMap::partition: count must be positive");
+	std::vector<size_t> order = mortonOrder();
+	std::vector<std::vector<std::string>> parts(count);
+	for (size_t i = 0; i < order.size(); i++)
+		parts[i * count / order.size()].push_back(getNodes()[order[i]]->getData().getName());
+	return parts;
+}
+
+void EarthMap::reserve(size_t place_count, size_t connection_count) {
+	// a connection is an edge each way
+	Graph<Place,connectionType>::reserve(place_count, 2*connection_count);
+}
+
+std::vector<const Place*> EarthMap::getPlaces() const {
+	std::vector<const Place*> res;
+	res.reserve(getNodes().size());
+	for (const Node<Place> *node: getNodes())
+		res.push_back(&node->getData());
+	return res;
+}
+
+std::vector<Connection> EarthMap::getConnections() const {
+	const Adjacency<Place,connectionType> &adj = getAdjacency();
+	std::vector<Connection> res;
+	for (size_t u = 0; u < adj.nodes.size(); u++) {
+		for (size_t k = adj.out_offsets[u]; k < adj.out_offsets[u+1]; k++) {
+			// the edge back has the same annotation
+			if (adj.out_targets[k] > u) {
+				Connection c = {adj.nodes[u]->getData().getName(),
+					adj.nodes[adj.out_targets[k]]->getData().getName(), adj.out_edges[k]->getAnnotation()};
+				res.push_back(c);
+			}
+		}
 	}
+	return res;
 }
 
+CompactMap EarthMap::compact() const {
+	return CompactMap(*this);
+}
+
+MemoryUsage EarthMap::memoryUsage() const {
+	MemoryUsage usage;
+	usage.add("graph: ", Graph<Place,connectionType>::memoryUsage());
+	size_t names = 0, keys = 0;
+	for (const Node<Place> *node: getNodes())
+		names += MemoryUsage::heap(node->getData().getName());
+	for (auto &place: places)
+		keys += MemoryUsage::heap(place.first);
+	usage.add("place names", names);
+	usage.add("places map", places.size() * (sizeof(decltype(places)::value_type) + MemoryUsage::tree_node) + keys);
+	std::lock_guard<std::mutex> lock(reachability.mutex);
+	if (reachability.valid) {
+		size_t sets = reachability.any.capacity();
+		for (auto &uf: reachability.by_type)
+			sets += uf.second.capacity();
+		usage.add("reachability index", sets * sizeof(std::atomic<size_t>)
+			+ reachability.by_type.size() * (sizeof(decltype(reachability.by_type)::value_type) + MemoryUsage::tree_node)
+			+ reachability.ids.size() * (sizeof(decltype(reachability.ids)::value_type) + MemoryUsage::hash_node)
+			+ reachability.ids.bucket_count() * sizeof(void*));
+	}
+	return usage;
+}
+
+bool EarthMap::reachable(const std::string &name1, const std::string &name2) const {
+	return reachable(getPlace(name1), getPlace(name2), nullptr);
+}
+
+bool EarthMap::reachable(const std::string &name1, const std::string &name2, connectionType ct) const {
+	return reachable(getPlace(name1), getPlace(name2), &ct);
+}
+
+bool EarthMap::reachable(const Node<Place> *n1, const Node<Place> *n2, const connectionType *ct) const {
+	if (n1 == nullptr || n2 == nullptr)
+		return false;
+	// addPlace grows ids and the union-finds under the same lock, so the
+	// lookups must not run outside it
+	std::lock_guard<std::mutex> lock(reachability.mutex);
+	if (!reachability.valid)
+		buildReachability();
+	size_t id1 = reachability.ids.at(n1), id2 = reachability.ids.at(n2);
+	if (ct == nullptr)
+		return reachability.any.same(id1, id2);
+	return reachability.by_type.at(*ct).same(id1, id2);
+}
+
+const std::vector<Spheric<3>>& EarthMap::getLocations() const {
+	const Adjacency<Place,connectionType> &adj = getAdjacency();
+	std::lock_guard<std::mutex> lock(location_cache.mutex);
+	if (!location_cache.valid || location_cache.revision != revision) {
+		location_cache.locations.clear();
+		location_cache.locations.reserve(adj.nodes.size());
+		for (const Node<Place> *node: adj.nodes)
+			location_cache.locations.push_back(node->getData().getLocation());
+		location_cache.revision = revision;
+		location_cache.valid = true;
+	}
+	return location_cache.locations;
+}
+
+void EarthMap::buildReachability() const {
+	const Adjacency<Place,connectionType> &adj = getAdjacency();
+	reachability.ids = adj.index;
+	reachability.any.assign(components());
+	for (connectionType ct: connectionTypes)
+		reachability.by_type[ct].assign(components(ct, 0));
+	reachability.valid = true;
+}
@@ -0,0 +1,388 @@
+#include "journal.h"
+
+#include <cerrno>
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <unistd.h>
+
+enum journalOp : uint8_t { ADD_PLACE, DELETE_PLACE, ADD_CONNECTION, REMOVE_CONNECTION };
+
+static const char journal_magic[8] = {'G', 'O', 'S', 'J', '1', 0, 0, 0};
+static const char snapshot_magic[8] = {'G', 'O', 'S', 'S', '1', 0, 0, 0};
+
+static std::runtime_error systemError(const std::string &what, const std::string &path) {
+	return std::runtime_error("JournaledMap: " + what + " " + path + ": " + std::strerror(errno));
+}
+
+// FNV-1a
+static uint32_t checksum(const char *data, size_t size) {
+	uint32_t hash = 2166136261u;
+	for (size_t i = 0; i < size; i++) {
+		hash ^= (unsigned char) data[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+template <class T>
+static void put(std::string &out, T value) {
+	out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+static void putString(std::string &out, const std::string &s) {
+	put<uint32_t>(out, s.size());
+	out += s;
+}
+
+// reads values from a buffer, failing once past its end
+class Reader {
+	const std::string &data;
+	size_t pos;
+public:
+	Reader(const std::string &data, size_t pos = 0) : data(data), pos(pos) {}
+	inline size_t position() const { return pos; }
+	inline bool done() const { return pos == data.size(); }
+	inline size_t left() const { return data.size() - pos; }
+	inline void skip(size_t size) { pos += std::min(size, left()); }
+	template <class T>
+	T get() {
+		T value;
+		if (data.size() - pos < sizeof(value))
+			throw std::runtime_error("JournaledMap: truncated data");
+		std::memcpy(&value, data.data() + pos, sizeof(value));
+		pos += sizeof(value);
+		return value;
+	}
+	std::string getString() {
+		uint32_t size = get<uint32_t>();
+		if (data.size() - pos < size)
+			throw std::runtime_error("JournaledMap: truncated data");
+		pos += size;
+		return data.substr(pos - size, size);
+	}
+};
+
+static bool exists(const std::string &path) {
+	struct stat st;
+	return stat(path.c_str(), &st) == 0;
+}
+
+static std::string readFile(const std::string &path) {
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		throw systemError("cannot open", path);
+	std::string data;
+	char buffer[1 << 16];
+	ssize_t n;
+	while ((n = read(fd, buffer, sizeof(buffer))) > 0)
+		data.append(buffer, n);
+	close(fd);
+	if (n < 0)
+		throw systemError("cannot read", path);
+	return data;
+}
+
+static void writeAll(int fd, const std::string &data, const std::string &path) {
+	size_t done = 0;
+	while (done < data.size()) {
+		ssize_t n = write(fd, data.data() + done, data.size() - done);
+		if (n < 0 && errno != EINTR)
+			throw systemError("cannot write", path);
+		if (n > 0)
+			done += n;
+	}
+}
+
+// makes the entries of a directory, such as a rename, durable
+static void syncDirectory(const std::string &path) {
+	int fd = open(path.c_str(), O_RDONLY | O_DIRECTORY);
+	if (fd < 0)
+		throw systemError("cannot open", path);
+	int res = fsync(fd);
+	close(fd);
+	if (res != 0)
+		throw systemError("cannot sync", path);
+}
+
+static std::string parentDirectory(std::string path) {
+	while (path.size() > 1 && path.back() == '/')
+		path.pop_back();
+	size_t slash = path.rfind('/');
+	if (slash == std::string::npos)
+		return ".";
+	return slash == 0 ? "/" : path.substr(0, slash);
+}
+
+// write to a temporary file then rename it over path
+static void replaceFile(const std::string &path, const std::string &data) {
+	std::string tmp = path + ".tmp";
+	int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+		throw systemError("cannot create", tmp);
+	try {
+		writeAll(fd, data, tmp);
+		if (fsync(fd) != 0)
+			throw systemError("cannot sync", tmp);
+	}
+	catch (...) {
+		close(fd);
+		throw;
+	}
+	close(fd);
+	if (rename(tmp.c_str(), path.c_str()) != 0)
+		throw systemError("cannot rename", tmp);
+	syncDirectory(parentDirectory(path));
+}
+
+JournaledMap::JournaledMap(EarthMap &map, const std::string &directory, size_t group,
+		size_t snapshot_records, uint64_t snapshot_bytes) :
+	map(map), directory(directory), group(std::max<size_t>(1, group)), snapshot_records(snapshot_records),
+	snapshot_bytes(snapshot_bytes), journal_fd(-1), journal_records(0), journal_bytes(0),
+	sequence(0), pending_count(0) {
+	if (!map.getPlaces().empty())
+		throw std::invalid_argument("JournaledMap::JournaledMap: map is not empty");
+	if (mkdir(directory.c_str(), 0755) == 0)
+		syncDirectory(parentDirectory(directory));
+	else if (errno != EEXIST)
+		throw systemError("cannot create", directory);
+	recover();
+}
+
+JournaledMap::~JournaledMap() {
+	// no snapshot here, the next run can take it
+	try {
+		flush();
+	}
+	catch (std::runtime_error &e) {
+		// nothing more can be done, the tail is lost as in a crash
+	}
+	if (journal_fd >= 0)
+		close(journal_fd);
+}
+
+void JournaledMap::addPlace(const std::string &name, double latitude, double longitude) {
+	map.addPlace(name, latitude, longitude);
+	std::string record;
+	put<uint8_t>(record, ADD_PLACE);
+	putString(record, name);
+	put(record, latitude);
+	put(record, longitude);
+	append(record);
+}
+
+void JournaledMap::deletePlace(const std::string &name) {
+	map.deletePlace(name);
+	std::string record;
+	put<uint8_t>(record, DELETE_PLACE);
+	putString(record, name);
+	append(record);
+}
+
+void JournaledMap::addConnection(const std::string &name1, const std::string &name2, connectionType ct) {
+	map.addConnection(name1, name2, ct);
+	std::string record;
+	put<uint8_t>(record, ADD_CONNECTION);
+	putString(record, name1);
+	putString(record, name2);
+	put<uint8_t>(record, ct);
+	append(record);
+}
+
+void JournaledMap::removeConnection(const std::string &name1, const std::string &name2, connectionType ct) {
+	map.removeConnection(name1, name2, ct);
+	std::string record;
+	put<uint8_t>(record, REMOVE_CONNECTION);
+	putString(record, name1);
+	putString(record, name2);
+	put<uint8_t>(record, ct);
+	append(record);
+}
+
+void JournaledMap::commit() {
+	flush();
+	if ((snapshot_records > 0 && journal_records >= snapshot_records)
+			|| (snapshot_bytes > 0 && journal_bytes >= snapshot_bytes))
+		snapshot();
+}
+
+void JournaledMap::flush() {
+	if (pending.empty())
+		return;
+	std::string path = directory + "/journal";
+	writeAll(journal_fd, pending, path);
+	if (fdatasync(journal_fd) != 0)
+		throw systemError("cannot sync", path);
+	journal_records += pending_count;
+	journal_bytes += pending.size();
+	pending.clear();
+	pending_count = 0;
+}
+
+void JournaledMap::snapshot() {
+	flush();
+	std::string data(snapshot_magic, sizeof(snapshot_magic));
+	put<uint64_t>(data, sequence);
+	std::vector<const Place*> places = map.getPlaces();
+	put<uint64_t>(data, places.size());
+	for (const Place *place: places) {
+		putString(data, place->getName());
+		// raw coordinates, restored exactly
+		put<int32_t>(data, place->getLocation().getRadius());
+		put(data, place->getLocation().getAngle(0));
+		put(data, place->getLocation().getAngle(1));
+	}
+	std::vector<Connection> connections = map.getConnections();
+	put<uint64_t>(data, connections.size());
+	for (const Connection &c: connections) {
+		putString(data, c.from);
+		putString(data, c.to);
+		put<uint8_t>(data, c.type);
+	}
+	put<uint32_t>(data, checksum(data.data(), data.size()));
+	replaceFile(directory + "/snapshot", data);
+	// a crash from here keeps the old journal, whose records up to
+	// sequence are then skipped
+	createJournal();
+}
+
+void JournaledMap::recover() {
+	std::string snapshot_path = directory + "/snapshot";
+	std::string journal_path = directory + "/journal";
+	if (exists(snapshot_path))
+		loadSnapshot(snapshot_path);
+	if (exists(journal_path)) {
+		uint64_t valid = replayJournal(journal_path);
+		// drop a torn tail so that new records follow the last good one
+		if (truncate(journal_path.c_str(), valid) != 0)
+			throw systemError("cannot truncate", journal_path);
+		journal_bytes = valid;
+		openJournal();
+	}
+	else {
+		createJournal();
+	}
+}
+
+void JournaledMap::loadSnapshot(const std::string &path) {
+	std::string data = readFile(path);
+	if (data.size() < sizeof(snapshot_magic) + sizeof(uint32_t)
+			|| std::memcmp(data.data(), snapshot_magic, sizeof(snapshot_magic)) != 0)
+		throw std::runtime_error("JournaledMap: not a snapshot " + path);
+	Reader tail(data, data.size() - sizeof(uint32_t));
+	if (tail.get<uint32_t>() != checksum(data.data(), data.size() - sizeof(uint32_t)))
+		throw std::runtime_error("JournaledMap: corrupted snapshot " + path);
+	Reader in(data, sizeof(snapshot_magic));
+	sequence = in.get<uint64_t>();
+	uint64_t count = in.get<uint64_t>();
+	map.reserve(count, 0);
+	for (uint64_t i = 0; i < count; i++) {
+		std::string name = in.getString();
+		int32_t radius = in.get<int32_t>();
+		double angles[2];
+		angles[0] = in.get<double>();
+		angles[1] = in.get<double>();
+		map.addPlace(name, Spheric<3>(radius, angles));
+	}
+	count = in.get<uint64_t>();
+	map.reserve(map.getPlaces().size(), count);
+	for (uint64_t i = 0; i < count; i++) {
+		std::string from = in.getString();
+		std::string to = in.getString();
+		map.addConnection(from, to, (connectionType) in.get<uint8_t>());
+	}
+}
+
+uint64_t JournaledMap::replayJournal(const std::string &path) {
+	std::string data = readFile(path);
+	if (data.size() < sizeof(journal_magic) + sizeof(uint64_t)
+			|| std::memcmp(data.data(), journal_magic, sizeof(journal_magic)) != 0)
+		throw std::runtime_error("JournaledMap: not a journal " + path);
+	Reader in(data, sizeof(journal_magic));
+	uint64_t record_sequence = in.get<uint64_t>();
+	if (record_sequence > sequence)
+		throw std::runtime_error("JournaledMap: journal is ahead of the snapshot " + path);
+	size_t valid = in.position();
+	while (!in.done()) {
+		std::string record;
+		try {
+			uint32_t size = in.get<uint32_t>();
+			uint32_t sum = in.get<uint32_t>();
+			if (in.left() < size)
+				break;
+			record = data.substr(in.position(), size);
+			if (checksum(record.data(), record.size()) != sum)
+				break;
+			in.skip(size);
+		}
+		catch (std::runtime_error &e) {
+			break;
+		}
+		valid = in.position();
+		journal_records++;
+		// records already in the snapshot
+		if (++record_sequence <= sequence)
+			continue;
+		apply(record);
+		sequence++;
+	}
+	return valid;
+}
+
+void JournaledMap::apply(const std::string &record) {
+	Reader in(record);
+	uint8_t op = in.get<uint8_t>();
+	std::string name = in.getString();
+	switch (op) {
+	case ADD_PLACE: {
+		double latitude = in.get<double>();
+		map.addPlace(name, latitude, in.get<double>());
+		break;
+	}
+	case DELETE_PLACE:
+		map.deletePlace(name);
+		break;
+	case ADD_CONNECTION: {
+		std::string name2 = in.getString();
+		map.addConnection(name, name2, (connectionType) in.get<uint8_t>());
+		break;
+	}
+	case REMOVE_CONNECTION: {
+		std::string name2 = in.getString();
+		map.removeConnection(name, name2, (connectionType) in.get<uint8_t>());
+		break;
+	}
+	default:
+		throw std::runtime_error("JournaledMap: unknown journal record");
+	}
+}
+
+void JournaledMap::append(const std::string &record) {
+	put<uint32_t>(pending, record.size());
+	put<uint32_t>(pending, checksum(record.data(), record.size()));
+	pending += record;
+	sequence++;
+	if (++pending_count >= group)
+		commit();
+}
+
+void JournaledMap::createJournal() {
+	std::string data(journal_magic, sizeof(journal_magic));
+	put<uint64_t>(data, sequence);
+	replaceFile(directory + "/journal", data);
+	journal_records = 0;
+	journal_bytes = data.size();
+	if (journal_fd >= 0)
+		close(journal_fd);
+	journal_fd = -1;
+	openJournal();
+}
+
+void JournaledMap::openJournal() {
+	std::string path = directory + "/journal";
+	journal_fd = open(path.c_str(), O_WRONLY | O_APPEND);
+	if (journal_fd < 0)
+		throw systemError("cannot open", path);
+}
@@ -0,0 +1,328 @@
+#include "landmarks.h"
+#include "earth_map.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <tuple>
+
+typedef Adjacency<Place,connectionType> MapAdjacency;
+
+static const char magic[8] = {'G', 'O', 'S', 'L', '2', 0, 0, 0};
+
+// FNV-1a of the connections sorted by names, each with its ends in name
+// order: the same for any numbering of the map
+static uint64_t fingerprint(const EarthMap &map) {
+	std::vector<std::tuple<std::string,std::string,uint8_t>> connections;
+	for (const Connection &c: map.getConnections())
+		connections.emplace_back(std::min(c.from, c.to), std::max(c.from, c.to), c.type);
+	std::sort(connections.begin(), connections.end());
+	uint64_t hash = 14695981039346656037ull;
+	auto mix = [&hash](const char *data, size_t size) {
+		for (size_t i = 0; i < size; i++) {
+			hash ^= (unsigned char) data[i];
+			hash *= 1099511628211ull;
+		}
+	};
+	for (auto &c: connections) {
+		// names with their terminating null, so that they cannot run together
+		mix(std::get<0>(c).c_str(), std::get<0>(c).size() + 1);
+		mix(std::get<1>(c).c_str(), std::get<1>(c).size() + 1);
+		mix(reinterpret_cast<const char*>(&std::get<2>(c)), 1);
+	}
+	return hash;
+}
+
+// the place farthest from the landmarks, or from a random place if there
+// is none yet; places out of reach of every landmark come first
+size_t Landmarks::farthest(const EarthMap &map, const std::vector<std::vector<double>> &columns, const std::vector<char> &is_landmark, std::mt19937 &rng) {
+	const size_t n = map.getAdjacency().nodes.size();
+	std::vector<std::vector<double>> start;
+	if (columns.empty()) {
+		start.emplace_back();
+		map.shortestPaths(rng() % n, {}, start.back());
+	}
+	const std::vector<std::vector<double>> &from = columns.empty() ? start : columns;
+	size_t best = n;
+	double best_distance = -1;
+	for (size_t v = 0; v < n; v++) {
+		if (is_landmark[v])
+			continue;
+		double closest = INFINITY;
+		for (const std::vector<double> &column: from)
+			closest = std::min(closest, column[v]);
+		if (closest > best_distance) {
+			best = v;
+			best_distance = closest;
+		}
+	}
+	return best;
+}
+
+// Goldberg and Werneck's avoid: in a shortest path tree from a random root,
+// weigh each place by how much the current landmarks underestimate its
+// distance from the root, then walk from the heaviest subtree without
+// landmark down to a leaf through the heaviest children
+size_t Landmarks::avoid(const EarthMap &map, const std::vector<std::vector<double>> &columns, const std::vector<char> &is_landmark, std::mt19937 &rng) {
+	const size_t n = map.getAdjacency().nodes.size();
+	const size_t root = rng() % n;
+	std::vector<double> dist;
+	std::vector<size_t> parent, order;
+	map.shortestPaths(root, {}, dist, false, &parent, &order);
+	std::vector<double> size(n, 0);
+	std::vector<char> covered(n, 0);
+	for (size_t v: order) {
+		double bound = 0;
+		for (const std::vector<double> &column: columns) {
+			double b = column[v] - column[root];
+			if (std::isfinite(b) && b > bound)
+				bound = b;
+		}
+		size[v] = dist[v] - std::min(bound, dist[v]);
+		covered[v] = is_landmark[v];
+	}
+	// children are settled after their parent
+	std::vector<std::vector<size_t>> children(n);
+	for (auto it = order.rbegin(); it != order.rend(); ++it) {
+		size_t v = *it, p = parent[v];
+		if (covered[v])
+			size[v] = 0;
+		if (p == n)
+			continue;
+		children[p].push_back(v);
+		size[p] += size[v];
+		if (covered[v])
+			covered[p] = 1;
+	}
+	size_t w = root;
+	for (size_t v: order)
+		if (size[v] > size[w])
+			w = v;
+	if (!(size[w] > 0))
+		return farthest(map, columns, is_landmark, rng);
+	while (!children[w].empty()) {
+		size_t heaviest = children[w].front();
+		for (size_t c: children[w])
+			if (size[c] > size[heaviest])
+				heaviest = c;
+		w = heaviest;
+	}
+	return w;
+}
+
+Landmarks::Landmarks(const EarthMap &map, unsigned count, landmarkSelection selection, unsigned nthreads) :
+	selection(selection), count(count), places(0), revision(0) {
+	build(map, nthreads);
+}
+
+bool Landmarks::isStale(const EarthMap &map) const {
+	return map.getRevision() != revision || map.getAdjacency().nodes.size() != places;
+}
+
+void Landmarks::refresh(const EarthMap &map, unsigned nthreads) {
+	build(map, nthreads);
+}
+
+void Landmarks::build(const EarthMap &map, unsigned nthreads) {
+	const MapAdjacency &adj = map.getAdjacency();
+	const size_t n = adj.nodes.size();
+	std::vector<size_t> chosen;
+	std::vector<char> is_landmark(n, 0);
+	for (const std::string &name: names) {
+		const Node<Place> *node = map.getPlace(name);
+		if (node != nullptr && chosen.size() < count) {
+			chosen.push_back(adj.index.at(node));
+			is_landmark[chosen.back()] = 1;
+		}
+	}
+	std::vector<std::vector<double>> from_columns(chosen.size());
+	parallelFor(chosen.size(), nthreads, [&](unsigned, size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++)
+			map.shortestPaths(chosen[i], {}, from_columns[i]);
+	});
+	// each new landmark depends on the bounds of the previous ones
+	std::mt19937 rng(count);
+	while (chosen.size() < std::min<size_t>(count, n)) {
+		size_t next = selection == AVOID ? avoid(map, from_columns, is_landmark, rng) : farthest(map, from_columns, is_landmark, rng);
+		chosen.push_back(next);
+		is_landmark[next] = 1;
+		from_columns.emplace_back();
+		map.shortestPaths(next, {}, from_columns.back());
+	}
+	std::vector<std::vector<double>> to_columns(chosen.size());
+	parallelFor(chosen.size(), nthreads, [&](unsigned, size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++)
+			map.shortestPaths(chosen[i], {}, to_columns[i], true);
+	});
+
+	const size_t k = chosen.size();
+	names.clear();
+	for (size_t l: chosen)
+		names.push_back(adj.nodes[l]->getData().getName());
+	to.resize(n * k);
+	from.resize(n * k);
+	for (size_t v = 0; v < n; v++) {
+		for (size_t i = 0; i < k; i++) {
+			to[v*k + i] = to_columns[i][v];
+			from[v*k + i] = from_columns[i][v];
+		}
+	}
+	places = n;
+	revision = map.getRevision();
+}
+
+long Landmarks::distance(const EarthMap &map, const std::string &name1, const std::string &name2, SearchScratch &scratch, size_t *settled) const {
+	if (isStale(map))
+		throw std::logic_error("Landmarks::distance: tables are stale, refresh them");
+	if (settled != nullptr)
+		*settled = 0;
+	const Node<Place> *n1 = map.getPlace(name1);
+	const Node<Place> *n2 = map.getPlace(name2);
+	if (!map.reachable(n1, n2, nullptr))
+		return -1;
+	const MapAdjacency &adj = map.getAdjacency();
+	const std::vector<Spheric<3>> &locations = map.getLocations();
+	const size_t n = adj.nodes.size(), k = names.size();
+	const size_t source = adj.index.at(n1), target = adj.index.at(n2);
+	const Spheric<3> &goal = locations[target];
+	const double *to_target = to.data() + target*k;
+	const double *from_target = from.data() + target*k;
+	// both bounds are consistent, and so is their maximum. A term is
+	// infinite when the landmark reaches only one of the places, the other
+	// term of the same landmark still holds.
+	auto bound = [&](size_t v) {
+		double res = distanceGrandCercle(locations[v], goal);
+		const double *to_v = to.data() + v*k;
+		const double *from_v = from.data() + v*k;
+		for (size_t i = 0; i < k; i++) {
+			double b1 = from_target[i] - from_v[i], b2 = to_v[i] - to_target[i];
+			if (b1 > res && b1 != INFINITY)
+				res = b1;
+			if (b2 > res && b2 != INFINITY)
+				res = b2;
+		}
+		return res;
+	};
+	scratch.reset(n);
+	std::vector<double> &dist = scratch.dist;
+	std::vector<uint32_t> &stamp = scratch.stamp;
+	const uint32_t reached = scratch.round, done = scratch.round + 1;
+	auto &heap = scratch.heap;
+	// min-heap on distance plus bound
+	auto later = [](const std::pair<double,size_t> &a, const std::pair<double,size_t> &b) {
+		return a.first > b.first;
+	};
+	dist[source] = 0;
+	stamp[source] = reached;
+	heap.push_back(std::make_pair(bound(source), source));
+	while (!heap.empty()) {
+		std::pop_heap(heap.begin(), heap.end(), later);
+		size_t u = heap.back().second;
+		heap.pop_back();
+		if (stamp[u] == done)
+			continue;
+		stamp[u] = done;
+		if (settled != nullptr)
+			(*settled)++;
+		if (u == target)
+			break;
+		const Spheric<3> &at = locations[u];
+		for (size_t e = adj.out_offsets[u]; e < adj.out_offsets[u+1]; e++) {
+			size_t v = adj.out_targets[e];
+			// the bound is consistent, a settled place is never improved
+			if (stamp[v] == done)
+				continue;
+			double d = dist[u] + distanceGrandCercle(at, locations[v]);
+			if (stamp[v] != reached || d < dist[v]) {
+				stamp[v] = reached;
+				dist[v] = d;
+				heap.push_back(std::make_pair(d + bound(v), v));
+				std::push_heap(heap.begin(), heap.end(), later);
+			}
+		}
+	}
+	return dist[target];
+}
+
+static void writeString(std::ofstream &out, const std::string &s) {
+	uint64_t length = s.size();
+	out.write(reinterpret_cast<const char*>(&length), sizeof(length));
+	out.write(s.data(), s.size());
+}
+
+static std::string readString(std::ifstream &in, const std::string &path) {
+	uint64_t length = 0;
+	in.read(reinterpret_cast<char*>(&length), sizeof(length));
+	if (!in || length > (1u << 20))
+		throw std::runtime_error("Landmarks::load: truncated file " + path);
+	std::string s(length, '\0');
+	in.read(&s[0], length);
+	return s;
+}
+
+void Landmarks::save(const std::string &path, const EarthMap &map) const {
+	if (isStale(map))
+		throw std::logic_error("Landmarks::save: tables are stale, refresh them");
+	const MapAdjacency &adj = map.getAdjacency();
+	std::ofstream out(path, std::ios::binary);
+	if (!out)
+		throw std::runtime_error("Landmarks::save: cannot open " + path);
+	uint64_t header[6] = {names.size(), places, adj.out_targets.size(), fingerprint(map), (uint64_t) selection, count};
+	out.write(magic, sizeof(magic));
+	out.write(reinterpret_cast<const char*>(header), sizeof(header));
+	for (const std::string &name: names)
+		writeString(out, name);
+	for (const Node<Place> *node: adj.nodes)
+		writeString(out, node->getData().getName());
+	out.write(reinterpret_cast<const char*>(from.data()), from.size() * sizeof(double));
+	out.write(reinterpret_cast<const char*>(to.data()), to.size() * sizeof(double));
+	if (!out)
+		throw std::runtime_error("Landmarks::save: cannot write " + path);
+}
+
+Landmarks Landmarks::load(const std::string &path, const EarthMap &map) {
+	std::ifstream in(path, std::ios::binary);
+	char buffer[sizeof(magic)];
+	uint64_t header[6];
+	in.read(buffer, sizeof(buffer));
+	in.read(reinterpret_cast<char*>(header), sizeof(header));
+	if (!in || std::memcmp(buffer, magic, sizeof(magic)) != 0 || header[4] > AVOID)
+		throw std::runtime_error("Landmarks::load: not a landmark file " + path);
+	const MapAdjacency &adj = map.getAdjacency();
+	const size_t k = header[0], n = header[1];
+	if (n != adj.nodes.size() || header[2] != adj.out_targets.size() || k > n || header[3] != fingerprint(map))
+		throw std::runtime_error("Landmarks::load: tables do not match the map " + path);
+	Landmarks res;
+	res.selection = (landmarkSelection) header[4];
+	res.count = header[5];
+	for (size_t i = 0; i < k; i++) {
+		res.names.push_back(readString(in, path));
+		if (map.getPlace(res.names.back()) == nullptr)
+			throw std::runtime_error("Landmarks::load: tables do not match the map " + path);
+	}
+	// rows of the file in the current numbering of the map
+	std::vector<size_t> rows(n);
+	for (size_t r = 0; r < n; r++) {
+		const Node<Place> *node = map.getPlace(readString(in, path));
+		if (node == nullptr)
+			throw std::runtime_error("Landmarks::load: tables do not match the map " + path);
+		rows[r] = adj.index.at(node);
+	}
+	std::vector<double> from(n * k), to(n * k);
+	in.read(reinterpret_cast<char*>(from.data()), from.size() * sizeof(double));
+	in.read(reinterpret_cast<char*>(to.data()), to.size() * sizeof(double));
+	if (!in)
+		throw std::runtime_error("Landmarks::load: truncated file " + path);
+	res.from.resize(n * k);
+	res.to.resize(n * k);
+	for (size_t r = 0; r < n; r++) {
+		std::copy(from.begin() + r*k, from.begin() + (r+1)*k, res.from.begin() + rows[r]*k);
+		std::copy(to.begin() + r*k, to.begin() + (r+1)*k, res.to.begin() + rows[r]*k);
+	}
+	res.places = n;
+	res.revision = map.getRevision();
+	return res;
+}
@@ -0,0 +1,89 @@
+#include "query_service.h"
+#include "scenario.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+
+typedef std::chrono::steady_clock Clock;
+
+struct Sample {
+	std::future<long> result;
+	Clock::time_point sent;
+};
+
+void report(const char *name, std::vector<double> &latencies, double elapsed) {
+	std::sort(latencies.begin(), latencies.end());
+	auto percentile = [&latencies](double p) {
+		return latencies[std::min(latencies.size()-1, (size_t) (p * latencies.size()))] * 1000;
+	};
+	std::cout << name << ": " << latencies.size()/elapsed << " queries/s, latency ms"
+		<< " p50 " << percentile(0.5)
+		<< " p90 " << percentile(0.9)
+		<< " p99 " << percentile(0.99)
+		<< " max " << latencies.back()*1000 << std::endl;
+}
+
+// each client sends window requests at once and waits for all of them;
+// sources are drawn among a few hot places so that batches can be grouped
+template <class Query>
+void run(const char *name, Query query, int side, int clients, int requests, int window) {
+	std::vector<std::thread> threads;
+	std::vector<std::vector<double>> latencies(clients);
+	Clock::time_point t0 = Clock::now();
+	for (int c = 0; c < clients; c++) {
+		threads.emplace_back([&, c] {
+			std::mt19937 rng(c);
+			std::uniform_int_distribution<int> hot(0, 15), any(0, side*side-1);
+			std::vector<Sample> samples;
+			for (int sent = 0; sent < requests; sent += window) {
+				for (int i = 0; i < window && sent + i < requests; i++) {
+					Sample s;
+					s.sent = Clock::now();
+					int from = hot(rng) * side * side / 16;
+					s.result = query("p" + std::to_string(from), "p" + std::to_string(any(rng)));
+					samples.push_back(std::move(s));
+				}
+				for (Sample &s: samples) {
+					s.result.get();
+					latencies[c].push_back(std::chrono::duration<double>(Clock::now() - s.sent).count());
+				}
+				samples.clear();
+			}
+		});
+	}
+	for (std::thread &t: threads)
+		t.join();
+	double elapsed = std::chrono::duration<double>(Clock::now() - t0).count();
+	std::vector<double> all;
+	for (auto &l: latencies)
+		all.insert(all.end(), l.begin(), l.end());
+	report(name, all, elapsed);
+}
+
+int main(int argc, char *argv[]) {
+	int side = argc > 1 ? std::atoi(argv[1]) : 50;
+	int clients = argc > 2 ? std::atoi(argv[2]) : 8;
+	int requests = argc > 3 ? std::atoi(argv[3]) : 200;
+	int window = argc > 4 ? std::atoi(argv[4]) : 16;
+	Scenario scenario(side, 42);
+	const EarthMap &map = scenario.getMap();
+	std::cout << side*side << " places, " << clients << " clients x "
+		<< requests << " requests, window " << window << std::endl;
+
+	// previous approach: one blocking call at a time behind a mutex
+	std::mutex mutex;
+	run("mutex", [&](const std::string &from, const std::string &to) {
+		std::lock_guard<std::mutex> lock(mutex);
+		std::promise<long> p;
+		p.set_value(map.distance(from, to));
+		return p.get_future();
+	}, side, clients, requests, window);
+
+	QueryService service(map);
+	run("service", [&](const std::string &from, const std::string &to) {
+		return service.distance(from, to);
+	}, side, clients, requests, window);
+	return 0;
+}
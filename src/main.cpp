@@ -1,8 +1,10 @@
 #include "test_graph.h"
 #include "test_spheric.h"
+#include "test_earth_map.h"
 
 int main() {
 	testGraph();
 	testSpheric();
+	testEarthMap();
 	return 0;
 }
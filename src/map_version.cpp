@@ -0,0 +1,174 @@
+#include "map_version.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <queue>
+
+MapVersion::MapVersion(const EarthMap &map) {
+	std::vector<const Place*> places = map.getPlaces();
+	if (places.size() >= npos)
+		throw std::length_error("MapVersion::MapVersion: map is too large for 32-bit ids");
+	auto names = std::make_shared<std::unordered_map<std::string,uint32_t>>();
+	std::vector<Site> all;
+	all.reserve(places.size());
+	for (const Place *place: places) {
+		names->emplace(place->getName(), all.size());
+		all.push_back(Site{*place, {}, false});
+	}
+	for (const Connection &c: map.getConnections()) {
+		uint32_t id1 = names->at(c.from), id2 = names->at(c.to);
+		const Spheric<3> &l1 = all[id1].place.getLocation(), &l2 = all[id2].place.getLocation();
+		all[id1].links.push_back(Link{id2, c.type, distanceGrandCercle(l1, l2)});
+		all[id2].links.push_back(Link{id1, c.type, distanceGrandCercle(l2, l1)});
+	}
+	base_names = names;
+	place_count = all.size();
+	sites = PersistentVector<Site>(std::move(all));
+}
+
+uint32_t MapVersion::getId(const std::string &name) const {
+	auto changed = changed_names.find(name);
+	if (changed != changed_names.end())
+		return changed->second;
+	auto base = base_names->find(name);
+	return base == base_names->end() ? npos : base->second;
+}
+
+bool MapVersion::hasPlace(const std::string &name) const {
+	return getId(name) != npos;
+}
+
+void MapVersion::addPlace(const std::string &name, double latitude, double longitude) {
+	addPlace(name, coordsEarth(latitude, longitude));
+}
+
+void MapVersion::addPlace(const std::string &name, const Spheric<3> &location) {
+	if (getId(name) != npos)
+		return;
+	if (sites.size() >= npos)
+		throw std::length_error("MapVersion::addPlace: map is too large for 32-bit ids");
+	changed_names[name] = sites.size();
+	sites.push_back(Site{Place(name, location), {}, false});
+	place_count++;
+}
+
+void MapVersion::deletePlace(const std::string &name) {
+	uint32_t id = getId(name);
+	if (id == npos)
+		return;
+	Site site = sites[id];
+	for (const Link &l: site.links) {
+		if (l.to == id)
+			continue;
+		Site other = sites[l.to];
+		other.links.erase(std::remove_if(other.links.begin(), other.links.end(), [id](const Link &back) {
+			return back.to == id;
+		}), other.links.end());
+		sites.set(l.to, std::move(other));
+	}
+	// the id is not reused, the site stays as a tombstone
+	site.links.clear();
+	site.deleted = true;
+	sites.set(id, std::move(site));
+	changed_names[name] = npos;
+	place_count--;
+}
+
+void MapVersion::addConnection(const std::string &name1, const std::string &name2, connectionType ct) {
+	uint32_t id1 = getId(name1), id2 = getId(name2);
+	if (id1 == npos || id2 == npos)
+		throw std::invalid_argument("MapVersion::addConnection: no such place");
+	for (const Link &l: sites[id1].links)
+		if (l.to == id2 && l.type == ct)
+			throw std::invalid_argument("MapVersion::addConnection: connection exists");
+	const Spheric<3> &l1 = sites[id1].place.getLocation(), &l2 = sites[id2].place.getLocation();
+	double length12 = distanceGrandCercle(l1, l2), length21 = distanceGrandCercle(l2, l1);
+	link(id1, id2, ct, length12);
+	link(id2, id1, ct, length21);
+}
+
+void MapVersion::link(uint32_t from, uint32_t to, connectionType ct, double length) {
+	Site site = sites[from];
+	site.links.push_back(Link{to, ct, length});
+	sites.set(from, std::move(site));
+}
+
+void MapVersion::removeConnection(const std::string &name1, const std::string &name2, connectionType ct) {
+	uint32_t id1 = getId(name1), id2 = getId(name2);
+	if (id1 == npos || id2 == npos)
+		throw std::invalid_argument("MapVersion::removeConnection: no such place");
+	auto unlink = [this, ct](uint32_t from, uint32_t to) {
+		Site site = sites[from];
+		auto it = std::find_if(site.links.begin(), site.links.end(), [to, ct](const Link &l) {
+			return l.to == to && l.type == ct;
+		});
+		if (it == site.links.end())
+			throw std::invalid_argument("MapVersion::removeConnection: no such connection");
+		site.links.erase(it);
+		sites.set(from, std::move(site));
+	};
+	unlink(id1, id2);
+	unlink(id2, id1);
+}
+
+std::vector<Connection> MapVersion::getConnections() const {
+	std::vector<Connection> res;
+	for (uint32_t i = 0; i < sites.size(); i++) {
+		const Site &site = sites[i];
+		for (const Link &l: site.links)
+			if (i < l.to)
+				res.push_back(Connection{site.place.getName(), sites[l.to].place.getName(), l.type});
+	}
+	return res;
+}
+
+long MapVersion::distance(const std::string &name1, const std::string &name2) const {
+	return distances(name1, std::vector<std::string>(1, name2)).front();
+}
+
+std::vector<long> MapVersion::distances(const std::string &source, const std::vector<std::string> &targets) const {
+	std::vector<long> res(targets.size(), -1);
+	uint32_t from = getId(source);
+	if (from == npos)
+		return res;
+	const size_t n = sites.size();
+	std::vector<char> goal(n, 0);
+	size_t remaining = 0;
+	for (const std::string &name: targets) {
+		uint32_t to = getId(name);
+		if (to != npos && !goal[to]) {
+			goal[to] = 1;
+			remaining++;
+		}
+	}
+	// same search as EarthMap::shortestPaths, the lengths are stored in the links
+	std::vector<double> dist(n, INFINITY);
+	std::vector<char> settled(n, 0);
+	typedef std::pair<double,uint32_t> Entry;
+	std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;
+	dist[from] = 0;
+	queue.push(Entry(0, from));
+	while (!queue.empty() && remaining > 0) {
+		uint32_t u = queue.top().second;
+		queue.pop();
+		if (settled[u])
+			continue;
+		settled[u] = 1;
+		if (goal[u])
+			remaining--;
+		for (const Link &l: sites[u].links) {
+			double d = dist[u] + l.length;
+			if (d < dist[l.to]) {
+				dist[l.to] = d;
+				queue.push(Entry(d, l.to));
+			}
+		}
+	}
+	for (size_t i = 0; i < targets.size(); i++) {
+		uint32_t to = getId(targets[i]);
+		if (to != npos && dist[to] != INFINITY)
+			res[i] = dist[to];
+	}
+	return res;
+}
@@ -0,0 +1,31 @@
+#include "memory_usage.h"
+
+#include <iomanip>
+
+void MemoryUsage::add(const std::string &name, size_t bytes) {
+	parts.push_back(std::make_pair(name, bytes));
+}
+
+void MemoryUsage::add(const std::string &prefix, const MemoryUsage &usage) {
+	for (auto &part: usage.parts)
+		add(prefix + part.first, part.second);
+}
+
+size_t MemoryUsage::total() const {
+	size_t total = 0;
+	for (auto &part: parts)
+		total += part.second;
+	return total;
+}
+
+size_t MemoryUsage::heap(const std::string &s) {
+	// libstdc++ keeps up to 15 characters inside the object
+	return s.capacity() > 15 ? s.capacity() + 1 + heap_overhead : 0;
+}
+
+std::ostream& operator<<(std::ostream &out, const MemoryUsage &usage) {
+	for (auto &part: usage.parts)
+		out << std::setw(32) << std::left << part.first << std::setw(12) << std::right << part.second << std::endl;
+	out << std::setw(32) << std::left << "total" << std::setw(12) << std::right << usage.total() << std::endl;
+	return out;
+}
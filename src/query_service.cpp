@@ -0,0 +1,81 @@
+#include "query_service.h"
+
+#include <algorithm>
+#include <map>
+
+QueryService::QueryService(const EarthMap &map, unsigned nworkers, size_t capacity, size_t batch) :
+	map(map), capacity(std::max<size_t>(1, capacity)), batch(std::max<size_t>(1, batch)), stopping(false) {
+	if (nworkers == 0)
+		nworkers = std::max(1u, std::thread::hardware_concurrency());
+	for (unsigned i = 0; i < nworkers; i++)
+		workers.emplace_back(&QueryService::work, this);
+}
+
+QueryService::~QueryService() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	not_empty.notify_all();
+	not_full.notify_all();
+	// workers drain the queue before leaving
+	for (std::thread &t: workers)
+		t.join();
+}
+
+std::future<long> QueryService::distance(const std::string &from, const std::string &to) {
+	std::unique_lock<std::mutex> lock(mutex);
+	not_full.wait(lock, [this] { return queue.size() < capacity || stopping; });
+	if (stopping)
+		throw std::runtime_error("QueryService::distance: service is stopping");
+	queue.push_back(Request());
+	Request &r = queue.back();
+	r.from = from;
+	r.to = to;
+	std::future<long> result = r.result.get_future();
+	lock.unlock();
+	not_empty.notify_one();
+	return result;
+}
+
+void QueryService::work() {
+	std::vector<Request> requests;
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			not_empty.wait(lock, [this] { return !queue.empty() || stopping; });
+			if (queue.empty())
+				return;
+			size_t count = std::min(batch, queue.size());
+			for (size_t i = 0; i < count; i++) {
+				requests.push_back(std::move(queue.front()));
+				queue.pop_front();
+			}
+		}
+		not_full.notify_all();
+		answer(requests);
+		requests.clear();
+	}
+}
+
+void QueryService::answer(std::vector<Request> &requests) {
+	std::map<std::string,std::vector<Request*>> by_source;
+	for (Request &r: requests)
+		by_source[r.from].push_back(&r);
+	for (auto &group: by_source) {
+		std::vector<std::string> targets;
+		for (Request *r: group.second)
+			targets.push_back(r->to);
+		// promises before answered are already satisfied
+		size_t answered = 0;
+		try {
+			std::vector<long> res = map.distances(group.first, targets);
+			for (; answered < res.size(); answered++)
+				group.second[answered]->result.set_value(res[answered]);
+		}
+		catch (...) {
+			for (size_t i = answered; i < group.second.size(); i++)
+				group.second[i]->result.set_exception(std::current_exception());
+		}
+	}
+}
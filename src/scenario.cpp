@@ -1,13 +1,28 @@
 #include "scenario.h"
 
+#include <algorithm>
+#include <random>
+
 Scenario::Scenario() {
 	initScenario();
 }
 
+Scenario::Scenario(int side, unsigned seed) {
+	initGrid(side, seed);
+}
+
 EarthMap& Scenario::getMap() {
 	return map;
 }
 
+MapVersion Scenario::fork() const {
+	if (!base || base_revision != map.getRevision()) {
+		base.reset(new MapVersion(map));
+		base_revision = map.getRevision();
+	}
+	return base->fork();
+}
+
 void Scenario::initScenario() {
 	map.addPlace("bordeaux", 44.84, -0.58);
 	map.addPlace("brest", 48.39, -4.49);
@@ -39,3 +54,28 @@ void Scenario::initScenario() {
 	map.addConnection("bordeaux", "paris", TRAIN);
 
 }
+
+// places on a jittered grid over western Europe, linked by TRAIN to their
+// grid neighbours and added in random order
+void Scenario::initGrid(int side, unsigned seed) {
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<double> jitter(-0.1, 0.1);
+	map.reserve(side*side, 2*side*(side-1));
+	std::vector<int> ids;
+	for (int i = 0; i < side*side; i++)
+		ids.push_back(i);
+	std::shuffle(ids.begin(), ids.end(), rng);
+	for (int id: ids) {
+		double latitude = 40 + 15.0 * (id / side) / side + jitter(rng);
+		double longitude = -5 + 20.0 * (id % side) / side + jitter(rng);
+		map.addPlace("p" + std::to_string(id), latitude, longitude);
+	}
+	std::shuffle(ids.begin(), ids.end(), rng);
+	for (int id: ids) {
+		int i = id / side, j = id % side;
+		if (j < side-1)
+			map.addConnection("p" + std::to_string(id), "p" + std::to_string(id+1), TRAIN);
+		if (i < side-1)
+			map.addConnection("p" + std::to_string(id), "p" + std::to_string(id+side), TRAIN);
+	}
+}
@@ -0,0 +1,20 @@
+#include "sharded_router.h"
+
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+
+// started by ShardedRouter with its end of the socket and the shard file
+int main(int argc, char **argv) {
+	if (argc != 3) {
+		std::cerr << "usage: " << argv[0] << " socket shard_file" << std::endl;
+		return 2;
+	}
+	try {
+		return ShardedRouter::runWorker(std::atoi(argv[1]), argv[2]);
+	}
+	catch (std::exception &e) {
+		std::cerr << argv[0] << ": " << e.what() << std::endl;
+		return 1;
+	}
+}
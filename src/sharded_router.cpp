@@ -0,0 +1,441 @@
+#include "sharded_router.h"
+
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <functional>
+#include <queue>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static const char shard_magic[8] = {'G', 'O', 'S', 'R', '1', 0, 0, 0};
+
+// Protocol, native byte order: a worker starts by sending the names of its
+// places then the connections leaving its shard (uint32 count each, names
+// as uint32 length and bytes, then local name, remote name and double
+// length). A request is the source then the targets (uint32 count then
+// each name), the reply one double distance per target, infinite when
+// unreachable. Closing the socket stops the worker.
+
+static void sendAll(int fd, const std::string &data) {
+	size_t done = 0;
+	while (done < data.size()) {
+		ssize_t n = send(fd, data.data() + done, data.size() - done, MSG_NOSIGNAL);
+		if (n < 0 && errno != EINTR)
+			throw std::runtime_error(std::string("ShardedRouter: cannot send: ") + std::strerror(errno));
+		if (n > 0)
+			done += n;
+	}
+}
+
+// false on end of stream before the first byte
+static bool receiveAll(int fd, void *buffer, size_t size) {
+	size_t done = 0;
+	while (done < size) {
+		ssize_t n = recv(fd, static_cast<char*>(buffer) + done, size - done, 0);
+		if (n == 0 && done == 0)
+			return false;
+		if (n == 0)
+			throw std::runtime_error("ShardedRouter: connection closed");
+		if (n < 0 && errno != EINTR)
+			throw std::runtime_error(std::string("ShardedRouter: cannot receive: ") + std::strerror(errno));
+		if (n > 0)
+			done += n;
+	}
+	return true;
+}
+
+template <class T>
+static void put(std::string &out, T value) {
+	out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+static void putString(std::string &out, const std::string &s) {
+	put<uint32_t>(out, s.size());
+	out += s;
+}
+
+template <class T>
+static T get(std::ifstream &in, const std::string &path) {
+	T value;
+	in.read(reinterpret_cast<char*>(&value), sizeof(value));
+	if (!in)
+		throw std::runtime_error("ShardedRouter: truncated file " + path);
+	return value;
+}
+
+static std::string getString(std::ifstream &in, const std::string &path) {
+	uint32_t size = get<uint32_t>(in, path);
+	if (size > (1u << 20))
+		throw std::runtime_error("ShardedRouter: truncated file " + path);
+	std::string s(size, '\0');
+	in.read(&s[0], size);
+	if (!in)
+		throw std::runtime_error("ShardedRouter: truncated file " + path);
+	return s;
+}
+
+static std::string receiveString(int fd) {
+	uint32_t size;
+	if (!receiveAll(fd, &size, sizeof(size)))
+		throw std::runtime_error("ShardedRouter: connection closed");
+	std::string s(size, '\0');
+	receiveAll(fd, &s[0], size);
+	return s;
+}
+
+// shard_worker next to the running executable
+static std::string defaultWorker() {
+	char path[4096];
+	ssize_t n = readlink("/proc/self/exe", path, sizeof(path));
+	if (n < 0 || n == sizeof(path))
+		throw std::runtime_error("ShardedRouter: cannot locate the running executable");
+	std::string exe(path, n);
+	return exe.substr(0, exe.rfind('/') + 1) + "shard_worker";
+}
+
+ShardedRouter::ShardedRouter(const EarthMap &map, unsigned count, const std::string &worker) {
+	char directory[] = "/tmp/sharded_router_XXXXXX";
+	if (mkdtemp(directory) == nullptr)
+		throw std::runtime_error(std::string("ShardedRouter: cannot create directory: ") + std::strerror(errno));
+	// the workers have loaded their files once started
+	auto clean = [&]() {
+		for (unsigned i = 0; i < count; i++)
+			std::remove((std::string(directory) + "/shard" + std::to_string(i)).c_str());
+		rmdir(directory);
+	};
+	try {
+		start(split(map, count, directory), worker);
+	}
+	catch (...) {
+		clean();
+		throw;
+	}
+	clean();
+}
+
+ShardedRouter::ShardedRouter(const std::vector<std::string> &files, const std::string &worker) {
+	start(files, worker);
+}
+
+ShardedRouter::~ShardedRouter() {
+	stop();
+}
+
+std::vector<std::string> ShardedRouter::split(const EarthMap &map, unsigned count, const std::string &directory) {
+	std::vector<std::vector<std::string>> parts = map.partition(count);
+	std::unordered_map<std::string,unsigned> shard_of;
+	for (unsigned i = 0; i < count; i++)
+		for (const std::string &name: parts[i])
+			shard_of[name] = i;
+	std::unordered_map<std::string,const Place*> places;
+	for (const Place *p: map.getPlaces())
+		places[p->getName()] = p;
+
+	std::vector<std::string> inner(count), cut(count);
+	std::vector<uint64_t> inner_count(count, 0), cut_count(count, 0);
+	for (const Connection &c: map.getConnections()) {
+		unsigned s1 = shard_of[c.from], s2 = shard_of[c.to];
+		if (s1 == s2) {
+			putString(inner[s1], c.from);
+			putString(inner[s1], c.to);
+			put<uint8_t>(inner[s1], c.type);
+			inner_count[s1]++;
+		}
+		else {
+			// the same length both ways
+			double d = distanceGrandCercle(places[c.from]->getLocation(), places[c.to]->getLocation());
+			putString(cut[s1], c.from);
+			putString(cut[s1], c.to);
+			put(cut[s1], d);
+			cut_count[s1]++;
+			putString(cut[s2], c.to);
+			putString(cut[s2], c.from);
+			put(cut[s2], d);
+			cut_count[s2]++;
+		}
+	}
+
+	std::vector<std::string> files;
+	for (unsigned i = 0; i < count; i++) {
+		std::string data(shard_magic, sizeof(shard_magic));
+		put<uint64_t>(data, parts[i].size());
+		for (const std::string &name: parts[i]) {
+			const Spheric<3> &location = places[name]->getLocation();
+			putString(data, name);
+			// raw coordinates, restored exactly
+			put<int32_t>(data, location.getRadius());
+			put(data, location.getAngle(0));
+			put(data, location.getAngle(1));
+		}
+		put(data, inner_count[i]);
+		data += inner[i];
+		put(data, cut_count[i]);
+		data += cut[i];
+		files.push_back(directory + "/shard" + std::to_string(i));
+		std::ofstream out(files.back(), std::ios::binary);
+		out.write(data.data(), data.size());
+		if (!out)
+			throw std::runtime_error("ShardedRouter::split: cannot write " + files.back());
+	}
+	return files;
+}
+
+void ShardedRouter::start(const std::vector<std::string> &files, const std::string &worker) {
+	const std::string program = worker.empty() ? defaultWorker() : worker;
+	try {
+		for (const std::string &file: files) {
+			// close on exec, so that a worker does not keep the sockets of
+			// the others open
+			int fds[2];
+			if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) != 0)
+				throw std::runtime_error(std::string("ShardedRouter: cannot create socket: ") + std::strerror(errno));
+			// built before forking, the child only execs
+			std::string socket = std::to_string(fds[1]);
+			char *argv[] = {const_cast<char*>(program.c_str()), &socket[0], const_cast<char*>(file.c_str()), nullptr};
+			pid_t pid = fork();
+			if (pid < 0) {
+				close(fds[0]);
+				close(fds[1]);
+				throw std::runtime_error(std::string("ShardedRouter: cannot fork: ") + std::strerror(errno));
+			}
+			if (pid == 0) {
+				fcntl(fds[1], F_SETFD, 0);
+				execv(program.c_str(), argv);
+				_exit(127);
+			}
+			close(fds[1]);
+			shards.push_back(Shard{pid, fds[0], {}});
+		}
+
+		// each worker starts with the places of its shard and the
+		// connections leaving it
+		std::vector<std::pair<unsigned,std::pair<std::string,std::string>>> ends;
+		std::vector<double> lengths;
+		for (unsigned i = 0; i < shards.size(); i++) {
+			uint32_t count;
+			if (!receiveAll(shards[i].socket, &count, sizeof(count)))
+				throw std::runtime_error("ShardedRouter: shard worker stopped");
+			for (uint32_t j = 0; j < count; j++)
+				shard_of[receiveString(shards[i].socket)] = i;
+			if (!receiveAll(shards[i].socket, &count, sizeof(count)))
+				throw std::runtime_error("ShardedRouter: shard worker stopped");
+			for (uint32_t j = 0; j < count; j++) {
+				std::string local = receiveString(shards[i].socket);
+				std::string remote = receiveString(shards[i].socket);
+				double length;
+				if (!receiveAll(shards[i].socket, &length, sizeof(length)))
+					throw std::runtime_error("ShardedRouter: shard worker stopped");
+				ends.push_back(std::make_pair(i, std::make_pair(local, remote)));
+				lengths.push_back(length);
+			}
+		}
+		for (size_t j = 0; j < ends.size(); j++) {
+			auto remote = shard_of.find(ends[j].second.second);
+			if (remote == shard_of.end() || remote->second == ends[j].first)
+				throw std::runtime_error("ShardedRouter: shard files do not match");
+			size_t i1 = addBoundary(ends[j].first, ends[j].second.first);
+			size_t i2 = addBoundary(remote->second, remote->first);
+			// the other way is sent by the other shard
+			overlay[i1].push_back(std::make_pair(i2, lengths[j]));
+		}
+
+		// distances between the boundary places of each shard, one request
+		// in flight per shard: a worker may block sending a large reply
+		// until it is read, so it must not be sent another request meanwhile
+		for (size_t k = 0; ; k++) {
+			bool sent = false;
+			for (unsigned i = 0; i < shards.size(); i++) {
+				if (k < shards[i].boundary.size()) {
+					request(i, shards[i].boundary[k], shards[i].boundary);
+					sent = true;
+				}
+			}
+			if (!sent)
+				break;
+			for (unsigned i = 0; i < shards.size(); i++) {
+				const std::vector<std::string> &boundary = shards[i].boundary;
+				if (k >= boundary.size())
+					continue;
+				std::vector<double> d = response(i, boundary.size());
+				size_t b = overlay_index[boundary[k]];
+				for (size_t j = 0; j < boundary.size(); j++)
+					if (d[j] > 0 && d[j] != INFINITY)
+						overlay[b].push_back(std::make_pair(overlay_index[boundary[j]], d[j]));
+			}
+		}
+	}
+	catch (...) {
+		// the destructor does not run when the constructor throws
+		stop();
+		throw;
+	}
+}
+
+size_t ShardedRouter::addBoundary(unsigned shard, const std::string &name) {
+	auto it = overlay_index.find(name);
+	if (it != overlay_index.end())
+		return it->second;
+	overlay_index[name] = overlay.size();
+	overlay.push_back(std::vector<std::pair<size_t,double>>());
+	shards[shard].boundary.push_back(name);
+	return overlay.size() - 1;
+}
+
+void ShardedRouter::stop() {
+	for (Shard &shard: shards) {
+		close(shard.socket);
+		waitpid(shard.pid, nullptr, 0);
+	}
+	shards.clear();
+}
+
+long ShardedRouter::distance(const std::string &from, const std::string &to) {
+	auto it1 = shard_of.find(from), it2 = shard_of.find(to);
+	if (it1 == shard_of.end() || it2 == shard_of.end())
+		return -1;
+	const unsigned s1 = it1->second, s2 = it2->second;
+	std::vector<std::string> targets = shards[s1].boundary;
+	if (s1 == s2)
+		targets.push_back(to);
+	// never two requests in flight to the same shard
+	request(s1, from, targets);
+	if (s2 != s1)
+		request(s2, to, shards[s2].boundary);
+	std::vector<double> d1 = response(s1, targets.size());
+	if (s2 == s1)
+		request(s2, to, shards[s2].boundary);
+	std::vector<double> d2 = response(s2, shards[s2].boundary.size());
+
+	double best = INFINITY;
+	if (s1 == s2)
+		best = d1.back();
+	// leaving the shard of from through the overlay, entering the one of to
+	std::vector<double> goal(overlay.size(), INFINITY);
+	for (size_t j = 0; j < shards[s2].boundary.size(); j++)
+		goal[overlay_index[shards[s2].boundary[j]]] = d2[j];
+	std::vector<double> dist(overlay.size(), INFINITY);
+	typedef std::pair<double,size_t> Entry;
+	std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;
+	for (size_t j = 0; j < shards[s1].boundary.size(); j++) {
+		size_t b = overlay_index[shards[s1].boundary[j]];
+		if (d1[j] < dist[b]) {
+			dist[b] = d1[j];
+			queue.push(Entry(dist[b], b));
+		}
+	}
+	while (!queue.empty() && queue.top().first < best) {
+		Entry e = queue.top();
+		queue.pop();
+		size_t u = e.second;
+		if (e.first > dist[u])
+			continue;
+		best = std::min(best, dist[u] + goal[u]);
+		for (auto &edge: overlay[u]) {
+			double d = dist[u] + edge.second;
+			if (d < dist[edge.first]) {
+				dist[edge.first] = d;
+				queue.push(Entry(d, edge.first));
+			}
+		}
+	}
+	return best == INFINITY ? -1 : (long) best;
+}
+
+void ShardedRouter::request(unsigned shard, const std::string &source, const std::vector<std::string> &targets) {
+	std::string message;
+	putString(message, source);
+	uint32_t count = targets.size();
+	message.append(reinterpret_cast<const char*>(&count), sizeof(count));
+	for (const std::string &t: targets)
+		putString(message, t);
+	sendAll(shards.at(shard).socket, message);
+}
+
+std::vector<double> ShardedRouter::response(unsigned shard, size_t count) {
+	std::vector<double> d(count);
+	if (count > 0 && !receiveAll(shards.at(shard).socket, d.data(), count * sizeof(double)))
+		throw std::runtime_error("ShardedRouter: shard worker stopped");
+	return d;
+}
+
+int ShardedRouter::runWorker(int socket, const std::string &file) {
+	std::ifstream in(file, std::ios::binary);
+	char buffer[sizeof(shard_magic)];
+	in.read(buffer, sizeof(buffer));
+	if (!in || std::memcmp(buffer, shard_magic, sizeof(shard_magic)) != 0)
+		throw std::runtime_error("ShardedRouter: not a shard file " + file);
+	EarthMap map;
+	uint64_t count = get<uint64_t>(in, file);
+	map.reserve(count, 0);
+	for (uint64_t i = 0; i < count; i++) {
+		std::string name = getString(in, file);
+		int32_t radius = get<int32_t>(in, file);
+		double angles[2];
+		angles[0] = get<double>(in, file);
+		angles[1] = get<double>(in, file);
+		map.addPlace(name, Spheric<3>(radius, angles));
+	}
+	count = get<uint64_t>(in, file);
+	map.reserve(map.getPlaces().size(), count);
+	for (uint64_t i = 0; i < count; i++) {
+		std::string from = getString(in, file);
+		std::string to = getString(in, file);
+		map.addConnection(from, to, (connectionType) get<uint8_t>(in, file));
+	}
+	std::vector<std::pair<std::pair<std::string,std::string>,double>> cut;
+	count = get<uint64_t>(in, file);
+	for (uint64_t i = 0; i < count; i++) {
+		std::string local = getString(in, file);
+		std::string remote = getString(in, file);
+		cut.push_back(std::make_pair(std::make_pair(local, remote), get<double>(in, file)));
+		if (map.getPlace(local) == nullptr)
+			throw std::runtime_error("ShardedRouter: no such place in " + file);
+	}
+	serve(socket, map, cut);
+	return 0;
+}
+
+void ShardedRouter::serve(int socket, const EarthMap &map, const std::vector<std::pair<std::pair<std::string,std::string>,double>> &cut) {
+	std::string hello;
+	std::vector<const Place*> places = map.getPlaces();
+	put<uint32_t>(hello, places.size());
+	for (const Place *place: places)
+		putString(hello, place->getName());
+	put<uint32_t>(hello, cut.size());
+	for (auto &c: cut) {
+		putString(hello, c.first.first);
+		putString(hello, c.first.second);
+		put(hello, c.second);
+	}
+	sendAll(socket, hello);
+	uint32_t size;
+	while (receiveAll(socket, &size, sizeof(size))) {
+		std::string source(size, '\0');
+		receiveAll(socket, &source[0], size);
+		uint32_t count;
+		receiveAll(socket, &count, sizeof(count));
+		std::vector<std::string> targets;
+		for (uint32_t i = 0; i < count; i++)
+			targets.push_back(receiveString(socket));
+		// exact lengths, rounding only once in the coordinator
+		const Adjacency<Place,connectionType> &adj = map.getAdjacency();
+		std::vector<size_t> goals;
+		for (const std::string &t: targets)
+			goals.push_back(adj.index.at(map.getPlace(t)));
+		std::vector<double> dist;
+		if (!goals.empty())
+			map.shortestPaths(adj.index.at(map.getPlace(source)), goals, dist);
+		std::vector<double> reply;
+		for (size_t g: goals)
+			reply.push_back(dist[g]);
+		sendAll(socket, std::string(reinterpret_cast<const char*>(reply.data()), reply.size() * sizeof(double)));
+	}
+	close(socket);
+}
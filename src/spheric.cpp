@@ -59,18 +59,138 @@ double distanceGrandCercle(const Spheric<3> &p1, const Spheric<3> &p2) {
 	else {
 		const double latitude_1 = p1.getLatitude() + ((p1.getRadius() < 0) ? M_PI:0.0);
 		const double latitude_2 = p2.getLatitude() + ((p2.getRadius() < 0) ? M_PI:0.0);
-		const double dlongitude = (p1.getLongitude() - p2.getLongitude());
-		const double dlatitude = (latitude_1 - latitude_2);
-		const double sdlatitude = sin(dlatitude / 2.0);
-		const double sdlongitude = sin(dlongitude / 2.0);
-		const double a = (sdlatitude*sdlatitude) +
-			(cos(latitude_1)*cos(latitude_2)*sdlongitude*sdlongitude);
-		res = R*2*atan2(sqrt(a), sqrt(1 - a));
+		res = distanceGrandCercle(latitude_1, p1.getLongitude(), latitude_2, p2.getLongitude(), R);
 	}
 	return res;
 }
 
+double distanceGrandCercle(double latitude_1, double longitude_1, double latitude_2, double longitude_2, double radius) {
+	const double dlongitude = (longitude_1 - longitude_2);
+	const double dlatitude = (latitude_1 - latitude_2);
+	const double sdlatitude = sin(dlatitude / 2.0);
+	const double sdlongitude = sin(dlongitude / 2.0);
+	const double a = (sdlatitude*sdlatitude) +
+		(cos(latitude_1)*cos(latitude_2)*sdlongitude*sdlongitude);
+	return radius*2*atan2(sqrt(a), sqrt(1 - a));
+}
+
+// latitude in [-pi/2, pi/2] and longitude in [-pi, pi] of the point itself,
+// a negative radius standing for the antipode
+static void trueCoordinates(const Spheric<3> &p, double &latitude, double &longitude) {
+	latitude = p.getLatitude();
+	longitude = p.getLongitude();
+	if (p.getRadius() < 0) {
+		latitude = -latitude;
+		longitude -= M_PI;
+	}
+}
+
+double distanceChord(const Cartesian &c1, const Cartesian &c2) {
+	const double dx = c1.x - c2.x, dy = c1.y - c2.y, dz = c1.z - c2.z;
+	return sqrt(dx*dx + dy*dy + dz*dz);
+}
+
+double distanceChord(const Spheric<3> &p1, const Spheric<3> &p2) {
+	if (std::abs(p1.getRadius()) != std::abs(p2.getRadius()))
+		return -1.0; // error!
+	return distanceChord(convertCartesian(p1), convertCartesian(p2));
+}
+
+double chordLength(double distance, double radius) {
+	return 2 * radius * sin(distance / (2 * radius));
+}
+
+double distanceEquirectangular(const Spheric<3> &p1, const Spheric<3> &p2) {
+	const double R = std::abs(p1.getRadius());
+	if (R != std::abs(p2.getRadius()))
+		return -1.0; // error!
+	double latitude_1, longitude_1, latitude_2, longitude_2;
+	trueCoordinates(p1, latitude_1, longitude_1);
+	trueCoordinates(p2, latitude_2, longitude_2);
+	return distanceEquirectangular(latitude_1, longitude_1, latitude_2, longitude_2, R);
+}
+
+double distanceEquirectangular(double latitude_1, double longitude_1, double latitude_2, double longitude_2, double radius) {
+	double dlongitude = longitude_1 - longitude_2;
+	// shortest way around
+	dlongitude -= 2*M_PI * std::round(dlongitude / (2*M_PI));
+	const double x = dlongitude * cos((latitude_1 + latitude_2) / 2);
+	const double y = latitude_1 - latitude_2;
+	return radius * sqrt(x*x + y*y);
+}
+
+// sine on [-pi/2, pi/2], Taylor series to x^13
+static double fastSin(double x) {
+	const double x2 = x*x;
+	return x * (1 + x2 * (-1.0/6 + x2 * (1.0/120 + x2 * (-1.0/5040
+		+ x2 * (1.0/362880 + x2 * (-1.0/39916800 + x2 * (1.0/6227020800)))))));
+}
+
+// square of the sine, any angle
+static double fastSin2(double x) {
+	x -= M_PI * std::round(x / M_PI);
+	const double s = fastSin(x);
+	return s*s;
+}
+
+// cosine on [-pi/2, pi/2]
+static double fastCos(double x) {
+	return fastSin(M_PI/2 - std::abs(x));
+}
+
+// arcsine on [0, 1]: Taylor series to x^11 below 0.5, Abramowitz and
+// Stegun 4.4.46 above (absolute error under 2e-8)
+static double fastAsin(double x) {
+	if (x < 0.5) {
+		const double x2 = x*x;
+		return x * (1 + x2 * (1.0/6 + x2 * (3.0/40 + x2 * (5.0/112
+			+ x2 * (35.0/1152 + x2 * (63.0/2816))))));
+	}
+	return M_PI/2 - sqrt(1 - x) * (1.5707963050 + x * (-0.2145988016 + x * (0.0889789874
+		+ x * (-0.0501743046 + x * (0.0308918810 + x * (-0.0170881256
+		+ x * (0.0066700901 + x * -0.0012624911)))))));
+}
+
+double distanceGrandCercleFast(const Spheric<3> &p1, const Spheric<3> &p2) {
+	const double R = std::abs(p1.getRadius());
+	if (R != std::abs(p2.getRadius()))
+		return -1.0; // error!
+	double latitude_1, longitude_1, latitude_2, longitude_2;
+	trueCoordinates(p1, latitude_1, longitude_1);
+	trueCoordinates(p2, latitude_2, longitude_2);
+	return distanceGrandCercleFast(latitude_1, longitude_1, latitude_2, longitude_2, R);
+}
+
+double distanceGrandCercleFast(double latitude_1, double longitude_1, double latitude_2, double longitude_2, double radius) {
+	const double a = fastSin2((latitude_1 - latitude_2) / 2.0) +
+		fastCos(latitude_1) * fastCos(latitude_2) * fastSin2((longitude_1 - longitude_2) / 2.0);
+	return radius * 2 * fastAsin(sqrt(std::min(1.0, std::max(0.0, a))));
+}
+
 Spheric<3> coordsEarth(double latitude, double longitude) {
 	return Spheric<3>(6371008, M_PI*latitude/180, M_PI*longitude/180);
 }
 
+
+// inserts two zero bits between each of the 21 lowest bits of v
+static uint64_t spreadBits(uint64_t v) {
+	v &= 0x1fffff;
+	v = (v | v << 32) & 0x1f00000000ffff;
+	v = (v | v << 16) & 0x1f0000ff0000ff;
+	v = (v | v << 8) & 0x100f00f00f00f00f;
+	v = (v | v << 4) & 0x10c30c30c30c30c3;
+	v = (v | v << 2) & 0x1249249249249249;
+	return v;
+}
+
+uint64_t mortonCode(const Cartesian &c, double radius) {
+	const double scale = (1 << 21) - 1;
+	const double coords[3] = {c.x, c.y, c.z};
+	uint64_t code = 0;
+	for (int i = 0; i < 3; i++) {
+		double v = (coords[i] / std::abs(radius) + 1) / 2;
+		v = std::min(1.0, std::max(0.0, v));
+		code |= spreadBits((uint64_t) (v * scale)) << (2 - i);
+	}
+	return code;
+}
@@ -0,0 +1,660 @@
+#include "test_earth_map.h"
+#include "scenario.h"
+#include "query_service.h"
+#include "journal.h"
+#include "sharded_router.h"
+#include "landmarks.h"
+#include <assert.h>
+#include <algorithm>
+#include <map>
+#include <set>
+#include <tuple>
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+void testEarthMapReachability();
+void testEarthMapReorder();
+void testEarthMapDistance();
+void testQueryService();
+void testDistanceMatrix();
+void testCompactMap();
+void testJournal();
+void testShardedRouter();
+void testIsochrone();
+void testMapVersion();
+void testLandmarks();
+
+void testEarthMap() {
+	testEarthMapReachability();
+	testEarthMapReorder();
+	testEarthMapDistance();
+	testQueryService();
+	testDistanceMatrix();
+	testCompactMap();
+	testJournal();
+	testShardedRouter();
+	testIsochrone();
+	testMapVersion();
+	testLandmarks();
+}
+
+void testEarthMapReachability() {
+	Scenario s;
+	EarthMap &map = s.getMap();
+	assert(map.reachable("edinburgh", "quimper"));
+	assert(map.reachable("edinburgh", "douvres", TRAIN));
+	assert(!map.reachable("edinburgh", "paris", TRAIN));
+	assert(map.reachable("calais", "bordeaux", TRAIN));
+	assert(!map.reachable("lehavre", "paris", TRAIN));
+	assert(map.reachable("lehavre", "paris", BOAT));
+	assert(!map.reachable("edinburgh", "nowhere"));
+
+	// incremental insertions
+	map.addPlace("glasgow", 55.8617, -4.2583);
+	assert(!map.reachable("glasgow", "edinburgh"));
+	map.addConnection("glasgow", "edinburgh", TRAIN);
+	assert(map.reachable("glasgow", "douvres", TRAIN));
+	assert(!map.reachable("glasgow", "douvres", BOAT));
+	map.addConnection("londres", "paris", TRAIN);
+	assert(map.reachable("glasgow", "quimper", TRAIN));
+	assert(map.distance("glasgow", "nowhere") == -1);
+
+	// deletions rebuild the index
+	map.removeConnection("londres", "paris", TRAIN);
+	assert(!map.reachable("glasgow", "quimper", TRAIN));
+	map.deletePlace("londres");
+	assert(!map.reachable("edinburgh", "paris"));
+	assert(map.reachable("plymouth", "paris"));
+	assert(map.distance("edinburgh", "paris") == -1);
+
+	// neighbours of a deleted place can be connected again
+	map.addConnection("edinburgh", "douvres", TRAIN);
+	map.addConnection("portsmouth", "plymouth", TRAIN);
+	assert(map.reachable("edinburgh", "paris"));
+	assert(map.getConnections().size() == 14);
+}
+
+void testEarthMapReorder() {
+	Scenario s1, s2, s3;
+	s2.getMap().reorderPlaces();
+	s3.getMap().reorderPlaces(CUTHILL_MCKEE);
+	const char *names[] = {"edinburgh", "paris", "quimper", "lehavre", "calais"};
+	for (const char *from: names) {
+		for (const char *to: names) {
+			long d = s1.getMap().distance(from, to);
+			assert(s2.getMap().distance(from, to) == d);
+			assert(s3.getMap().distance(from, to) == d);
+			assert(s2.getMap().reachable(from, to, TRAIN) == s1.getMap().reachable(from, to, TRAIN));
+		}
+	}
+	s2.getMap().addPlace("glasgow", 55.8617, -4.2583);
+	s2.getMap().addConnection("glasgow", "edinburgh", TRAIN);
+	assert(s2.getMap().reachable("glasgow", "londres", TRAIN));
+
+	// reordering after deleting a connected place
+	for (placeOrder order: {MORTON, CUTHILL_MCKEE}) {
+		Scenario s4;
+		long d = s4.getMap().distance("plymouth", "paris");
+		s4.getMap().deletePlace("calais");
+		s4.getMap().reorderPlaces(order);
+		assert(s4.getMap().distance("plymouth", "paris") == d);
+		assert(s4.getMap().distance("douvres", "paris") > s1.getMap().distance("douvres", "paris"));
+	}
+}
+
+void testEarthMapDistance() {
+	Scenario s;
+	EarthMap &map = s.getMap();
+	Spheric<3> londres = coordsEarth(51.507222, -0.1275);
+	Spheric<3> douvres = coordsEarth(45.9897, 5.3739);
+	Spheric<3> calais = coordsEarth(50.948056, 1.856389);
+	Spheric<3> paris = coordsEarth(48.856613, 2.352222);
+	assert(map.distance("londres", "londres") == 0);
+	long direct = distanceGrandCercle(londres, douvres);
+	assert(map.distance("londres", "douvres") == direct);
+	assert(map.distance("douvres", "londres") == direct);
+	// shortest of londres-douvres-calais-paris and londres-portsmouth-lehavre-paris
+	long d = map.distance("londres", "paris");
+	assert(d > 0);
+	assert(d <= (long) (distanceGrandCercle(londres, douvres) + distanceGrandCercle(douvres, calais)
+			+ distanceGrandCercle(calais, paris)));
+	assert(map.distance("paris", "londres") == d);
+	std::vector<std::string> targets = {"paris", "douvres", "nowhere", "londres"};
+	std::vector<long> all = map.distances("londres", targets);
+	assert(all.size() == 4);
+	assert(all[0] == d && all[1] == direct && all[2] == -1 && all[3] == 0);
+	assert(map.distances("nowhere", targets) == std::vector<long>(4, -1));
+}
+
+void testQueryService() {
+	Scenario s;
+	const EarthMap &map = s.getMap();
+	const char *names[] = {"edinburgh", "paris", "quimper", "lehavre", "nowhere"};
+	// small capacity and batches to exercise back-pressure and grouping
+	QueryService service(map, 3, 4, 3);
+	std::vector<std::future<long>> results;
+	for (const char *from: names)
+		for (const char *to: names)
+			results.push_back(service.distance(from, to));
+	size_t i = 0;
+	for (const char *from: names)
+		for (const char *to: names)
+			assert(results[i++].get() == map.distance(from, to));
+}
+
+void testDistanceMatrix() {
+	Scenario s;
+	const EarthMap &map = s.getMap();
+	std::vector<std::string> few = {"edinburgh", "nowhere", "bordeaux"};
+	std::vector<std::string> many = {"paris", "lehavre", "quimper", "londres", "nowhere", "calais"};
+	for (unsigned threads = 1; threads <= 2; threads++) {
+		// forward searches, then backward ones
+		DistanceMatrix m1 = map.distanceMatrix(few, many, threads);
+		DistanceMatrix m2 = map.distanceMatrix(many, few, threads);
+		assert(m1.rows() == 3 && m1.cols() == 6);
+		assert(m2.rows() == 6 && m2.cols() == 3);
+		for (size_t i = 0; i < few.size(); i++) {
+			assert((uintptr_t) m1.row(i) % DistanceMatrix::alignment == 0);
+			for (size_t j = 0; j < many.size(); j++) {
+				assert(m1(i, j) == map.distance(few[i], many[j]));
+				assert(m2(j, i) == map.distance(many[j], few[i]));
+			}
+		}
+	}
+	DistanceMatrix m = map.distanceMatrix(few, many);
+	const char *path = "test_distance_matrix.bin";
+	m.save(path);
+	DistanceMatrix loaded = DistanceMatrix::load(path);
+	std::remove(path);
+	assert(loaded.rows() == m.rows() && loaded.cols() == m.cols());
+	for (size_t i = 0; i < m.rows(); i++)
+		for (size_t j = 0; j < m.cols(); j++)
+			assert(loaded(i, j) == m(i, j));
+	// headers which do not match the data, one overflowing rows * cols
+	uint64_t headers[3][2] = {{3, 7}, {1ull << 61, 8}, {1ull << 62, 0}};
+	for (const uint64_t *header: headers) {
+		m.save(path);
+		std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+		file.seekp(8);
+		file.write(reinterpret_cast<const char*>(header), 2 * sizeof(uint64_t));
+		file.close();
+		bool thrown = false;
+		try {
+			DistanceMatrix::load(path);
+		}
+		catch (const std::runtime_error&) {
+			thrown = true;
+		}
+		std::remove(path);
+		assert(thrown);
+	}
+}
+
+void testCompactMap() {
+	Scenario s;
+	const EarthMap &map = s.getMap();
+	CompactMap compact = map.compact();
+	assert(compact.size() == 12);
+	assert(compact.getRadius() == 6371008);
+	uint32_t id = compact.getId("paris");
+	assert(id != CompactMap::npos);
+	assert(compact.getName(id) == "paris");
+	assert(compact.getId("nowhere") == CompactMap::npos);
+	assert(std::abs(compact.getLatitude(id) - M_PI*48.856613/180) < 1e-9);
+	assert(std::abs(compact.getLongitude(id) - M_PI*2.352222/180) < 1e-9);
+	// west of Greenwich, stored with a negative radius by Spheric
+	id = compact.getId("brest");
+	assert(std::abs(compact.getLongitude(id) - M_PI*-4.49/180) < 1e-9);
+	const char *names[] = {"edinburgh", "paris", "quimper", "lehavre", "bordeaux"};
+	for (const char *from: names) {
+		for (const char *to: names) {
+			long d = map.distance(from, to);
+			// at most a few connections, 16 mm each
+			assert(std::abs(compact.distance(from, to) - d) <= 1);
+		}
+	}
+	assert(compact.distance("paris", "nowhere") == -1);
+
+	MemoryUsage usage = map.memoryUsage();
+	assert(usage.total() > 0);
+	assert(usage.parts.front().first == "graph: node objects");
+	assert(compact.memoryUsage().total() < usage.total());
+}
+
+bool sameMaps(const EarthMap &m1, const EarthMap &m2) {
+	std::vector<const Place*> p1 = m1.getPlaces(), p2 = m2.getPlaces();
+	if (p1.size() != p2.size())
+		return false;
+	std::map<std::string,const Place*> places;
+	for (const Place *p: p1)
+		places[p->getName()] = p;
+	for (const Place *p: p2)
+		if (places.count(p->getName()) == 0 || places[p->getName()]->getLocation() != p->getLocation())
+			return false;
+	std::set<std::tuple<std::string,std::string,int>> c1, c2;
+	for (const Connection &c: m1.getConnections())
+		c1.insert(std::make_tuple(std::min(c.from, c.to), std::max(c.from, c.to), c.type));
+	for (const Connection &c: m2.getConnections())
+		c2.insert(std::make_tuple(std::min(c.from, c.to), std::max(c.from, c.to), c.type));
+	return c1 == c2;
+}
+
+// the same mutations on a journaled map and on a plain one
+void journalMutations(JournaledMap &journal, EarthMap &plain, int from, int to) {
+	for (int i = from; i < to; i++) {
+		std::string name = "p" + std::to_string(i);
+		journal.addPlace(name, 45 + i * 0.1, -2 + i * 0.05);
+		plain.addPlace(name, 45 + i * 0.1, -2 + i * 0.05);
+		if (i > 0) {
+			std::string previous = "p" + std::to_string(i-1);
+			connectionType ct = i % 3 == 0 ? BOAT : TRAIN;
+			journal.addConnection(previous, name, ct);
+			plain.addConnection(previous, name, ct);
+		}
+		if (i % 5 == 4) {
+			std::string previous = "p" + std::to_string(i-1);
+			connectionType ct = i % 3 == 0 ? BOAT : TRAIN;
+			journal.removeConnection(previous, name, ct);
+			plain.removeConnection(previous, name, ct);
+		}
+		if (i % 7 == 6) {
+			journal.deletePlace("p" + std::to_string(i-3));
+			plain.deletePlace("p" + std::to_string(i-3));
+			// bridge the gap between the former neighbours
+			std::string before = "p" + std::to_string(i-4), after = "p" + std::to_string(i-2);
+			journal.addConnection(before, after, TRAIN);
+			plain.addConnection(before, after, TRAIN);
+		}
+	}
+}
+
+void testJournal() {
+	char directory[] = "/tmp/test_journal_XXXXXX";
+	assert(mkdtemp(directory) != nullptr);
+	std::string dir = directory;
+	EarthMap plain;
+	{
+		EarthMap map;
+		JournaledMap journal(map, dir, 4);
+		journalMutations(journal, plain, 0, 30);
+		assert(sameMaps(map, plain));
+	}
+	// journal only
+	{
+		EarthMap map;
+		JournaledMap journal(map, dir, 4);
+		assert(sameMaps(map, plain));
+		assert(journal.getSequence() > 30);
+		journal.snapshot();
+		journalMutations(journal, plain, 30, 45);
+		journal.commit();
+	}
+	// snapshot and journal tail
+	uint64_t sequence;
+	{
+		EarthMap map;
+		JournaledMap journal(map, dir);
+		assert(sameMaps(map, plain));
+		assert(map.distance("p10", "p20") == plain.distance("p10", "p20"));
+		sequence = journal.getSequence();
+	}
+	// a torn record at the end is dropped
+	int fd = open((dir + "/journal").c_str(), O_WRONLY | O_APPEND);
+	assert(fd >= 0);
+	assert(write(fd, "\x20\0\0\0garbage", 11) == 11);
+	close(fd);
+	{
+		EarthMap map;
+		JournaledMap journal(map, dir);
+		assert(sameMaps(map, plain));
+		assert(journal.getSequence() == sequence);
+		journalMutations(journal, plain, 45, 50);
+	}
+	{
+		EarthMap map;
+		JournaledMap journal(map, dir);
+		assert(sameMaps(map, plain));
+		bool thrown = false;
+		try {
+			JournaledMap again(map, dir);
+		}
+		catch (std::invalid_argument &e) {
+			thrown = true;
+		}
+		assert(thrown);
+	}
+	std::remove((dir + "/journal").c_str());
+	std::remove((dir + "/snapshot").c_str());
+
+	// snapshots taken by commit() keep the journal under the limit
+	EarthMap limited;
+	struct stat st;
+	{
+		EarthMap map;
+		JournaledMap journal(map, dir, 4, 0, 512);
+		for (int i = 0; i < 40; i += 5) {
+			journalMutations(journal, limited, i, i + 5);
+			journal.commit();
+			assert(stat((dir + "/journal").c_str(), &st) == 0 && st.st_size < 512);
+		}
+		assert(stat((dir + "/snapshot").c_str(), &st) == 0);
+	}
+	// a crash after the snapshot is renamed but before the journal is
+	// leaves the new snapshot next to the old journal it covers
+	{
+		EarthMap map;
+		JournaledMap journal(map, dir, 4);
+		assert(sameMaps(map, limited));
+		journalMutations(journal, limited, 40, 42);
+		journal.commit();
+		std::ifstream in(dir + "/journal", std::ios::binary);
+		std::string old_journal((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+		in.close();
+		assert(old_journal.size() > 16);
+		journal.snapshot();
+		sequence = journal.getSequence();
+		std::rename((dir + "/journal").c_str(), (dir + "/journal.tmp").c_str());
+		std::ofstream out(dir + "/journal", std::ios::binary);
+		out << old_journal;
+	}
+	{
+		EarthMap map;
+		JournaledMap journal(map, dir, 4, 10);
+		assert(sameMaps(map, limited));
+		assert(journal.getSequence() == sequence);
+		journalMutations(journal, limited, 42, 45);
+	}
+	{
+		EarthMap map;
+		JournaledMap journal(map, dir);
+		assert(sameMaps(map, limited));
+		assert(journal.getSequence() > sequence);
+	}
+	std::remove((dir + "/journal").c_str());
+	std::remove((dir + "/journal.tmp").c_str());
+	std::remove((dir + "/snapshot").c_str());
+	rmdir(directory);
+}
+
+void testShardedRouter() {
+	Scenario grid(12, 1);
+	const EarthMap &map = grid.getMap();
+	std::vector<std::vector<std::string>> parts = map.partition(4);
+	std::set<std::string> all;
+	for (auto &part: parts) {
+		assert(part.size() == 36);
+		all.insert(part.begin(), part.end());
+	}
+	assert(all.size() == 144);
+
+	// workers started from shard files written beforehand
+	char directory[] = "/tmp/test_shards_XXXXXX";
+	assert(mkdtemp(directory) != nullptr);
+	std::vector<std::string> files = ShardedRouter::split(map, 3, directory);
+	assert(files.size() == 3);
+	{
+		ShardedRouter from_files(files);
+		assert(from_files.getShardCount() == 3);
+		for (int i = 0; i < 144; i += 13)
+			assert(std::abs(from_files.distance("p" + std::to_string(i), "p143") - map.distance("p" + std::to_string(i), "p143")) <= 1);
+	}
+	// workers which cannot start are all waited for, no other is running yet
+	bool thrown = false;
+	try {
+		ShardedRouter missing(files, std::string(directory) + "/no_worker");
+	}
+	catch (std::runtime_error &e) {
+		thrown = true;
+	}
+	assert(thrown);
+	assert(waitpid(-1, nullptr, WNOHANG) == -1 && errno == ECHILD);
+	for (const std::string &file: files)
+		std::remove(file.c_str());
+	rmdir(directory);
+
+	ShardedRouter router(map, 4);
+	assert(router.getShardCount() == 4);
+	assert(router.getOverlaySize() > 0 && router.getOverlaySize() < 144);
+	for (int i = 0; i < 144; i += 7) {
+		for (int j = 0; j < 144; j += 11) {
+			std::string from = "p" + std::to_string(i), to = "p" + std::to_string(j);
+			long d = map.distance(from, to);
+			assert(std::abs(router.distance(from, to) - d) <= 1);
+		}
+	}
+	assert(router.distance("p0", "nowhere") == -1);
+
+	// disconnected places
+	Scenario s;
+	s.getMap().addPlace("glasgow", 55.8617, -4.2583);
+	ShardedRouter small(s.getMap(), 3);
+	assert(small.distance("glasgow", "paris") == -1);
+	assert(std::abs(small.distance("edinburgh", "quimper") - s.getMap().distance("edinburgh", "quimper")) <= 1);
+	assert(small.distance("paris", "paris") == 0);
+
+	// boundary replies larger than the socket buffers
+	Scenario large(80, 42);
+	ShardedRouter two(large.getMap(), 2);
+	assert(two.getBoundary(0).size() > 150);
+	for (int i = 0; i < 6400; i += 1601)
+		assert(std::abs(two.distance("p" + std::to_string(i), "p6399") - large.getMap().distance("p" + std::to_string(i), "p6399")) <= 1);
+}
+
+void testIsochrone() {
+	Scenario s;
+	const EarthMap &map = s.getMap();
+	SearchScratch scratch;
+	const long budgets[] = {0, 300000, 800000, 2000000};
+	for (long budget: budgets) {
+		auto iso = map.isochrone("londres", budget, scratch);
+		std::map<std::string,long> found(iso.begin(), iso.end());
+		assert(found.size() == iso.size());
+		for (size_t i = 1; i < iso.size(); i++)
+			assert(iso[i-1].second <= iso[i].second);
+		for (const Place *p: map.getPlaces()) {
+			long d = map.distance("londres", p->getName());
+			bool within = d != -1 && d <= budget;
+			assert(found.count(p->getName()) == (within ? 1u : 0u));
+			if (within)
+				assert(found[p->getName()] == d);
+		}
+	}
+	assert(map.isochrone("londres", 0, scratch).size() == 1);
+	assert(map.isochrone("nowhere", 1000000, scratch).empty());
+	// no overflow at the largest budget, every reachable place is in range
+	assert(map.isochrone("londres", LONG_MAX, scratch).size() == map.getPlaces().size());
+
+	// restricted to one connection type
+	auto train = map.isochrone("paris", 10000000, TRAIN, scratch);
+	std::set<std::string> names;
+	for (auto &r: train) {
+		assert(map.reachable("paris", r.first, TRAIN));
+		names.insert(r.first);
+	}
+	assert(names.count("calais") && names.count("quimper"));
+	assert(!names.count("lehavre") && !names.count("londres"));
+	auto boat = map.isochrone("paris", 10000000, BOAT, scratch);
+	assert(boat.size() == 3 && boat[1].first == "lehavre");
+
+	// batch mode agrees with single searches
+	Scenario grid(15, 3);
+	std::vector<std::string> origins;
+	for (int i = 0; i < 225; i += 13)
+		origins.push_back("p" + std::to_string(i));
+	origins.push_back("nowhere");
+	auto batch = grid.getMap().isochrones(origins, 400000, 4);
+	assert(batch.size() == origins.size());
+	for (size_t i = 0; i < origins.size(); i++)
+		assert(batch[i] == grid.getMap().isochrone(origins[i], 400000, scratch));
+	assert(batch.back().empty());
+}
+
+void testMapVersion() {
+	Scenario s;
+	const char *names[] = {"edinburgh", "paris", "quimper", "lehavre", "portsmouth", "bordeaux"};
+	MapVersion base = s.fork();
+	assert(base.getPlaceCount() == 12);
+	assert(base.getConnections().size() == s.getMap().getConnections().size());
+	for (const char *from: names)
+		for (const char *to: names)
+			assert(base.distance(from, to) == s.getMap().distance(from, to));
+
+	// what if the ferries to Le Havre stop, on a fork and on a live copy
+	MapVersion closed = base.fork();
+	closed.removeConnection("portsmouth", "lehavre", BOAT);
+	closed.deletePlace("calais");
+	closed.addPlace("glasgow", 55.8617, -4.2583);
+	closed.addConnection("glasgow", "edinburgh", TRAIN);
+	Scenario live;
+	live.getMap().removeConnection("portsmouth", "lehavre", BOAT);
+	live.getMap().deletePlace("calais");
+	live.getMap().addPlace("glasgow", 55.8617, -4.2583);
+	live.getMap().addConnection("glasgow", "edinburgh", TRAIN);
+	assert(closed.getPlaceCount() == 12 && !closed.hasPlace("calais"));
+	assert(base.hasPlace("calais") && !base.hasPlace("glasgow"));
+	for (const char *from: names) {
+		for (const char *to: names) {
+			assert(base.distance(from, to) == s.getMap().distance(from, to));
+			assert(closed.distance(from, to) == live.getMap().distance(from, to));
+		}
+		assert(closed.distance("glasgow", from) == live.getMap().distance("glasgow", from));
+	}
+	assert(closed.distance("portsmouth", "lehavre") != base.distance("portsmouth", "lehavre"));
+	assert(closed.distance("paris", "calais") == -1);
+	bool thrown = false;
+	try {
+		closed.removeConnection("portsmouth", "lehavre", BOAT);
+	}
+	catch (std::invalid_argument &e) {
+		thrown = true;
+	}
+	assert(thrown);
+
+	// a fork shares every block it does not change
+	Scenario grid(30, 2);
+	MapVersion v1 = grid.fork();
+	MapVersion v2 = grid.fork();
+	assert(v2.sharedBlocks(v1) == v1.blockCount());
+	v2.removeConnection("p0", "p1", TRAIN);
+	// the places are inserted in shuffled order, the two ends may be apart
+	assert(v2.sharedBlocks(v1) >= v1.blockCount() - 2);
+	v2.addPlace("extra", 0, 0);
+	v2.addConnection("extra", "p899", TRAIN);
+	// 900 places fill 15 blocks of 64, the last one has room
+	assert(v2.blockCount() == v1.blockCount());
+	assert(v2.sharedBlocks(v1) >= v1.blockCount() - 4);
+	assert(v1.distance("p0", "p1") == grid.getMap().distance("p0", "p1"));
+	assert(v2.distance("p0", "p1") > v1.distance("p0", "p1"));
+	assert(v1.distance("p0", "extra") == -1 && v2.distance("p0", "extra") > 0);
+	// changes to the map itself start a new base
+	grid.getMap().removeConnection("p0", "p1", TRAIN);
+	MapVersion v3 = grid.fork();
+	assert(v3.sharedBlocks(v1) == 0 && v3.sharedBlocks(grid.fork()) == v3.blockCount());
+	assert(v3.distance("p0", "p1") == v2.distance("p0", "p1"));
+}
+
+void testLandmarks() {
+	Scenario s;
+	EarthMap &map = s.getMap();
+	// shared with isochrones, whose searches leave other stamps behind
+	SearchScratch scratch;
+	const char *names[] = {"edinburgh", "paris", "quimper", "lehavre", "calais", "brest"};
+	const landmarkSelection selections[] = {FARTHEST, AVOID};
+	for (landmarkSelection selection: selections) {
+		Landmarks landmarks(map, 4, selection);
+		assert(landmarks.size() == 4 && !landmarks.isStale(map));
+		for (const char *from: names)
+			for (const char *to: names)
+				assert(landmarks.distance(map, from, to, scratch) == map.distance(from, to));
+		map.isochrone("paris", 500000, scratch);
+	}
+
+	// edits make the tables stale until they are refreshed
+	Landmarks landmarks(map, 3);
+	std::vector<std::string> before = landmarks.getLandmarks();
+	map.removeConnection("portsmouth", "lehavre", BOAT);
+	assert(landmarks.isStale(map));
+	bool thrown = false;
+	try {
+		landmarks.distance(map, "londres", "paris", scratch);
+	}
+	catch (std::logic_error &e) {
+		thrown = true;
+	}
+	assert(thrown);
+	landmarks.refresh(map, 2);
+	assert(!landmarks.isStale(map));
+	for (const std::string &name: before)
+		if (name != "portsmouth" && name != "lehavre")
+			assert(std::find(landmarks.getLandmarks().begin(), landmarks.getLandmarks().end(), name) != landmarks.getLandmarks().end());
+	map.addPlace("glasgow", 55.8617, -4.2583);
+	landmarks.refresh(map);
+	assert(landmarks.distance(map, "londres", "paris", scratch) == map.distance("londres", "paris"));
+	assert(landmarks.distance(map, "glasgow", "paris", scratch) == -1);
+	assert(landmarks.distance(map, "nowhere", "paris", scratch) == -1);
+
+	// a wall across the grid with a single gap at the west end
+	Scenario grid(30, 6);
+	EarthMap &g = grid.getMap();
+	for (int j = 1; j < 30; j++)
+		g.removeConnection("p" + std::to_string(14*30 + j), "p" + std::to_string(15*30 + j), TRAIN);
+	Landmarks none(g, 0), alt(g, 8, AVOID, 4);
+	size_t plain = 0, goal_directed = 0;
+	for (int j = 10; j < 30; j += 4) {
+		std::string from = "p" + std::to_string(13*30 + j), to = "p" + std::to_string(16*30 + j);
+		size_t settled1, settled2;
+		long d = g.distance(from, to);
+		assert(none.distance(g, from, to, scratch, &settled1) == d);
+		assert(alt.distance(g, from, to, scratch, &settled2) == d);
+		plain += settled1;
+		goal_directed += settled2;
+	}
+	assert(2 * goal_directed < plain);
+
+	// saved tables are matched by name on a renumbered copy of the map
+	char path[] = "/tmp/test_landmarks_XXXXXX";
+	int fd = mkstemp(path);
+	assert(fd != -1);
+	close(fd);
+	alt.save(path, g);
+	Scenario copy(30, 6);
+	EarthMap &c = copy.getMap();
+	thrown = false;
+	try {
+		Landmarks::load(path, c);
+	}
+	catch (std::runtime_error &e) {
+		thrown = true;
+	}
+	assert(thrown);
+	// same names and counts, the gap at the east end instead
+	for (int j = 0; j < 29; j++)
+		c.removeConnection("p" + std::to_string(14*30 + j), "p" + std::to_string(15*30 + j), TRAIN);
+	thrown = false;
+	try {
+		Landmarks::load(path, c);
+	}
+	catch (std::runtime_error &e) {
+		thrown = true;
+	}
+	assert(thrown);
+	c.addConnection("p" + std::to_string(14*30), "p" + std::to_string(15*30), TRAIN);
+	c.removeConnection("p" + std::to_string(14*30 + 29), "p" + std::to_string(15*30 + 29), TRAIN);
+	c.reorderPlaces();
+	Landmarks loaded = Landmarks::load(path, c);
+	assert(loaded.getLandmarks() == alt.getLandmarks());
+	for (int i = 0; i < 900; i += 97) {
+		std::string from = "p" + std::to_string(i), to = "p" + std::to_string(899 - i);
+		assert(loaded.distance(c, from, to, scratch) == g.distance(from, to));
+	}
+	std::remove(path);
+}
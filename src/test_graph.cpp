@@ -1,15 +1,27 @@
 #include "test_graph.h"
 #include "graph.h"
+#include "persistent_vector.h"
 #include <assert.h>
+#include <mutex>
 
 void testGraphAddDelete();
 void testGraphUtils();
+void testGraphParallel();
+void testGraphComponents();
+void testGraphReorder();
+void testGraphEmplace();
+void testPersistentVector();
 
 void testGraph() {
 	testNode();
 	testEdge();
 	testGraphAddDelete();
 	testGraphUtils();
+	testGraphParallel();
+	testGraphComponents();
+	testGraphReorder();
+	testGraphEmplace();
+	testPersistentVector();
 }
 
 void testNode() {
@@ -72,6 +84,15 @@ void testGraphAddDelete() {
 	assert(edges.size() == 2);
 	g.deleteEdges(1, 3);
 	assert(edges.size() == 0);
+
+	// deleting a node drops its edges from its neighbours' lists too
+	g.addEdge(5, 1, 2);
+	g.addEdge(6, 2, 1);
+	g.deleteNode(2);
+	assert(edges.size() == 0);
+	g.addEdge(5, 1, 3);
+	assert(g.connected(5, 1, 3) && !g.connected(6, 1, 3));
+	assert(edges.size() == 1);
 }
 
 struct _test_breadthFirst {
@@ -135,3 +156,201 @@ void testGraphUtils() {
 		assert(test2.b[i] >= 2);
 }
 
+
+struct _test_parallelBreadthFirst {
+	std::mutex *mutex;
+	std::map<int,unsigned> *depths;
+	void operator()(const Node<int> *node, unsigned depth) {
+		std::lock_guard<std::mutex> lock(*mutex);
+		// each node is reached only once
+		assert(depths->find(node->getData()) == depths->end());
+		(*depths)[node->getData()] = depth;
+	}
+};
+
+void testGraphParallel() {
+	// 20x20 grid, node i*20+j linked both ways to its right and lower neighbours
+	Graph<int,int> g;
+	std::vector<const Node<int>*> n;
+	for (int i = 0; i < 400; i++)
+		n.push_back(g.addNode(i));
+	for (int i = 0; i < 20; i++) {
+		for (int j = 0; j < 20; j++) {
+			if (j < 19) {
+				g.addEdge(0, n[i*20+j], n[i*20+j+1]);
+				g.addEdge(0, n[i*20+j+1], n[i*20+j]);
+			}
+			if (i < 19) {
+				g.addEdge(0, n[i*20+j], n[(i+1)*20+j]);
+				g.addEdge(0, n[(i+1)*20+j], n[i*20+j]);
+			}
+		}
+	}
+	const Adjacency<int,int> &adj = g.getAdjacency();
+	assert(adj.nodes.size() == 400);
+	assert(adj.out_targets.size() == g.getEdges().size());
+	assert(adj.out_offsets[1] - adj.out_offsets[0] == 2);
+	for (unsigned threads = 1; threads <= 4; threads++) {
+		std::mutex mutex;
+		std::map<int,unsigned> depths;
+		struct _test_parallelBreadthFirst test = {&mutex, &depths};
+		g.parallelBreadthFirst(0, test, threads);
+		assert(depths.size() == 400);
+		for (int i = 0; i < 20; i++)
+			for (int j = 0; j < 20; j++)
+				assert(depths[i*20+j] == (unsigned) (i+j));
+	}
+	// structural changes are seen by the next traversal
+	g.deleteEdges(n[0], n[1]);
+	g.deleteEdges(n[0], n[20]);
+	std::mutex mutex;
+	std::map<int,unsigned> depths;
+	struct _test_parallelBreadthFirst test = {&mutex, &depths};
+	g.parallelBreadthFirst(n[0], test, 2);
+	assert(depths.size() == 1);
+}
+
+void testGraphComponents() {
+	Graph<int,int> g;
+	for (int i = 0; i < 6; i++)
+		g.addNode(i);
+	g.addEdge(1, 0, 1);
+	g.addEdge(2, 2, 1);
+	g.addEdge(1, 3, 4);
+	g.addEdge(2, 4, 3);
+	for (unsigned threads = 1; threads <= 3; threads++) {
+		std::vector<size_t> c = g.components(threads);
+		assert(c.size() == 6);
+		assert(c[0] == 0 && c[1] == 0 && c[2] == 0);
+		assert(c[3] == 3 && c[4] == 3);
+		assert(c[5] == 5);
+		c = g.components(1, threads);
+		assert(c[0] == 0 && c[1] == 0 && c[2] == 2);
+		assert(c[3] == 3 && c[4] == 3);
+	}
+	UnionFind uf(3);
+	assert(uf.add() == 3);
+	assert(uf.unite(3, 1));
+	assert(!uf.unite(1, 3));
+	assert(uf.find(3) == 1);
+	assert(uf.same(1, 3) && !uf.same(0, 3));
+}
+
+void testGraphReorder() {
+	// path 0-1-2-3-4 inserted in scrambled order
+	Graph<int,int> g;
+	int values[5] = {3, 0, 4, 1, 2};
+	for (int v: values)
+		g.addNode(v);
+	for (int i = 0; i < 4; i++) {
+		g.addEdge(0, i, i+1);
+		g.addEdge(0, i+1, i);
+	}
+	std::vector<size_t> order = g.reverseCuthillMcKee();
+	assert(order.size() == 5);
+	g.reorder(order);
+	const std::vector<Node<int>*> &nodes = g.getNodes();
+	// a path is laid out from one end to the other
+	int first = nodes[0]->getData();
+	assert(first == 0 || first == 4);
+	for (int i = 0; i < 5; i++)
+		assert(nodes[i]->getData() == (first == 0 ? i : 4-i));
+	// edges follow the node order
+	const Adjacency<int,int> &adj = g.getAdjacency();
+	for (size_t u = 0; u < 5; u++)
+		for (size_t k = adj.out_offsets[u]; k < adj.out_offsets[u+1]; k++)
+			assert(adj.out_targets[k] + 1 == u || adj.out_targets[k] == u + 1);
+	const std::vector<Edge<int>*> &edges = g.getEdges();
+	assert(edges.size() == 8);
+	assert(adj.out_edges[0] == edges[0]);
+	assert(g.connected(0, 2, 3) && g.connected(0, 3, 2));
+	bool thrown = false;
+	try {
+		g.reorder(std::vector<size_t>(5, 0));
+	}
+	catch (std::invalid_argument &e) {
+		thrown = true;
+	}
+	assert(thrown);
+}
+
+// payload counting its copies
+struct _test_payload {
+	static int copies;
+	std::string name;
+	int value;
+	_test_payload(const std::string &name, int value) : name(name), value(value) {}
+	_test_payload(const _test_payload &p) : name(p.name), value(p.value) { copies++; }
+	_test_payload(_test_payload &&p) = default;
+	_test_payload& operator=(const _test_payload &p) { name = p.name; value = p.value; copies++; return *this; }
+	_test_payload& operator=(_test_payload &&p) = default;
+	bool operator==(const _test_payload &p) const { return name == p.name && value == p.value; }
+};
+int _test_payload::copies = 0;
+
+void testGraphEmplace() {
+	Graph<_test_payload,_test_payload> g;
+	g.reserve(3, 2);
+	const std::vector<Node<_test_payload>*> &nodes = g.getNodes();
+	const Node<_test_payload> *n1 = g.emplaceNode("a", 1);
+	const Node<_test_payload> *n2 = g.addNode(_test_payload("b", 2));
+	_test_payload c("c", 3);
+	const Node<_test_payload> *n3 = g.addNode(c);
+	assert(_test_payload::copies == 1);
+	assert(nodes.size() == 3 && nodes.capacity() == 3);
+	assert(n1->getData().name == "a" && n2->getData().value == 2 && n3->getData() == c);
+	const Edge<_test_payload> *e = g.emplaceEdge(n1, n2, "ab", 0);
+	assert(e->getAnnotation().name == "ab");
+	g.emplaceEdge(n2, n1, _test_payload("ba", 0));
+	assert(_test_payload::copies == 1);
+	assert(g.getEdges().size() == 2 && g.getEdges().capacity() == 2);
+	assert(g.connected(_test_payload("ab", 0), n1, n2));
+	bool thrown = false;
+	try {
+		g.emplaceEdge(n1, n2, "ab", 0);
+	}
+	catch (std::invalid_argument &e) {
+		thrown = true;
+	}
+	assert(thrown);
+	Node<_test_payload> outside(std::in_place, "d", 4);
+	thrown = false;
+	try {
+		g.emplaceEdge(n1, &outside, "ad", 0);
+	}
+	catch (std::invalid_argument &e) {
+		thrown = true;
+	}
+	assert(thrown);
+	assert(g.getEdges().size() == 2);
+}
+
+void testPersistentVector() {
+	PersistentVector<int> v1;
+	for (int i = 0; i < 5000; i++)
+		v1.push_back(i);
+	PersistentVector<int> v2 = v1;
+	v2.set(4242, -1);
+	v2.push_back(5000);
+	assert(v1.size() == 5000 && v2.size() == 5001);
+	assert(v1[4242] == 4242 && v2[4242] == -1 && v2.at(5000) == 5000);
+	// 79 blocks of 64, two of them copied
+	assert(v1.blockCount() == 79 && v2.sharedBlocks(v1) == 77);
+
+	std::vector<int> values(5000);
+	for (int i = 0; i < 5000; i++)
+		values[i] = i;
+	PersistentVector<int> v3(values);
+	for (int i = 0; i < 5000; i += 7)
+		assert(v3[i] == i);
+	v3.push_back(5000);
+	assert(v3[5000] == 5000 && v3.blockCount() == 79);
+	bool thrown = false;
+	try {
+		v3.at(5001);
+	}
+	catch (std::out_of_range &e) {
+		thrown = true;
+	}
+	assert(thrown);
+}
@@ -6,10 +6,12 @@
 
 void testSpheric4D();
 void testSpheric3D();
+void testSphericApproximations();
 
 void testSpheric() {
 	testSpheric4D();
 	testSpheric3D();
+	testSphericApproximations();
 }
 
 bool equals(double val, double ref, double rel_error) {
@@ -103,4 +105,58 @@ void testSpheric3D() {
 	assert(equals(distanceGrandCercle(p1,p2), 454440, 0.001));
 	p2 = coordsEarth(-18.933333, 47.516667); //antananarivo
 	assert(equals(distanceGrandCercle(p1,p2), 8757070, 0.001));
+
+	// Z-order: the key grows with each coordinate
+	Cartesian c1 = {-1, -1, -1}, c2 = {1, 1, 1}, c3 = {0, 0, 0.5}, c4 = {0, 0, 0.6};
+	assert(mortonCode(c1, 1) == 0);
+	assert(mortonCode(c2, 1) == (uint64_t(1) << 63) - 1);
+	assert(mortonCode(c3, 1) < mortonCode(c4, 1));
+	assert(mortonCode(c3, 2) < mortonCode(c3, 1));
+}
+
+void testSphericApproximations() {
+	const double R = 6371008;
+	Spheric<3> paris = coordsEarth(48.856613, 2.352222);
+	Spheric<3> places[] = {
+		coordsEarth(48.8, 2.4), // 7 km
+		coordsEarth(51.507222, -0.1275), // london
+		coordsEarth(51.45, -2.583333), // bristol
+		coordsEarth(-18.933333, 47.516667), // antananarivo
+		coordsEarth(-48.856613, -177.647778), // antipode
+	};
+	double previous = 0;
+	for (const Spheric<3> &p: places) {
+		double d = distanceGrandCercle(paris, p);
+		double chord = distanceChord(paris, p);
+		assert(chord <= d + 1e-6);
+		assert(d - chord <= d*d*d/(24*R*R) + 1e-6);
+		assert(equals(chordLength(d, R), chord, 1e-9));
+		// chord keeps the order of distances
+		assert(chord > previous);
+		previous = chord;
+		assert(std::abs(distanceGrandCercleFast(paris, p) - d) <= std::max(1e-3, d*1e-5));
+	}
+	// the chord error is the documented bound up to higher order terms,
+	// 1.03 km at 1000 km
+	Spheric<3> equator = coordsEarth(0, 0);
+	for (double d: {1e4, 1e5, 1e6, 5e6}) {
+		Spheric<3> p = coordsEarth(d / R * 180 / M_PI, 0);
+		double error = distanceGrandCercle(equator, p) - distanceChord(equator, p);
+		double bound = d*d*d/(24*R*R);
+		assert(error <= bound + 1e-6 && error >= 0.99*bound);
+	}
+	assert(equals(1e6*1e6*1e6/(24*R*R), 1026, 1e-3));
+	double d = distanceGrandCercle(paris, places[0]);
+	assert(equals(distanceEquirectangular(paris, places[0]), d, 1e-4));
+	d = distanceGrandCercle(paris, places[2]);
+	assert(equals(distanceEquirectangular(paris, places[2]), d, 1e-2));
+	// across the antimeridian
+	Spheric<3> p1 = coordsEarth(10, 179.9), p2 = coordsEarth(10, -179.9);
+	d = distanceGrandCercle(p1, p2);
+	assert(equals(distanceEquirectangular(p1, p2), d, 1e-4));
+	assert(equals(distanceGrandCercleFast(p1, p2), d, 1e-5));
+	assert(equals(distanceChord(convertCartesian(p1), convertCartesian(p2)), d, 1e-5));
+	p1 = coordsEarth(0, 0) * 2;
+	assert(distanceChord(paris, p1) == -1.0);
+	assert(distanceGrandCercleFast(paris, p1) == -1.0);
 }
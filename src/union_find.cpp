@@ -0,0 +1,76 @@
+#include "union_find.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+UnionFind::UnionFind(size_t size) :
+	_parent(new std::atomic<size_t>[size]), _size(size), _capacity(size) {
+	for (size_t i = 0; i < size; i++)
+		_parent[i].store(i, std::memory_order_relaxed);
+}
+
+size_t UnionFind::add() {
+	if (_size == _capacity) {
+		_capacity = std::max<size_t>(16, 2*_capacity);
+		std::unique_ptr<std::atomic<size_t>[]> parent(new std::atomic<size_t>[_capacity]);
+		for (size_t i = 0; i < _size; i++)
+			parent[i].store(_parent[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+		_parent = std::move(parent);
+	}
+	_parent[_size].store(_size, std::memory_order_relaxed);
+	return _size++;
+}
+
+void UnionFind::assign(const std::vector<size_t> &roots) {
+	if (roots.size() > _capacity) {
+		_parent.reset(new std::atomic<size_t>[roots.size()]);
+		_capacity = roots.size();
+	}
+	_size = roots.size();
+	for (size_t i = 0; i < _size; i++) {
+		if (roots[i] >= _size)
+			throw std::invalid_argument("UnionFind::assign: root out of range");
+		_parent[i].store(roots[i], std::memory_order_relaxed);
+	}
+}
+
+size_t UnionFind::find(size_t i) {
+	if (i >= _size)
+		throw std::out_of_range("UnionFind::find: i is out of range");
+	size_t parent = _parent[i].load(std::memory_order_relaxed);
+	while (parent != i) {
+		// path halving, losing the race only leaves a longer path
+		size_t grandparent = _parent[parent].load(std::memory_order_relaxed);
+		_parent[i].compare_exchange_weak(parent, grandparent, std::memory_order_relaxed);
+		i = parent;
+		parent = _parent[i].load(std::memory_order_relaxed);
+	}
+	return i;
+}
+
+bool UnionFind::unite(size_t a, size_t b) {
+	while (true) {
+		a = find(a);
+		b = find(b);
+		if (a == b)
+			return false;
+		// link the larger root under the smaller one
+		if (a < b)
+			std::swap(a, b);
+		size_t expected = a;
+		if (_parent[a].compare_exchange_strong(expected, b, std::memory_order_relaxed))
+			return true;
+	}
+}
+
+bool UnionFind::same(size_t a, size_t b) {
+	while (true) {
+		a = find(a);
+		b = find(b);
+		if (a == b)
+			return true;
+		// a may have been linked meanwhile
+		if (_parent[a].load(std::memory_order_relaxed) == a)
+			return false;
+	}
+}